@@ -1,47 +1,241 @@
 #include "buffer.h"
+#include "cpuplacement.h"
 #include <algorithm>
 #include <errno.h>
+#include <mutex>
+#include <new>
 
-//vector<char>初始化
-Buffer::Buffer(int initBufferSize): buffer_(initBufferSize), readIndex_(0), writeIndex_(0) {}
+//块大小分级：小请求用4KB，数据多时逐级增大，最大64KB；超过64KB的块按实际大小分配，不缓存
+static const size_t SLAB_CLASSES = 3;
+static const size_t SLAB_SIZE[SLAB_CLASSES] = { 4096, 16384, 65536 };
+static const size_t SLAB_CACHED[SLAB_CLASSES] = { 256, 64, 16 }; //每线程每级最多缓存的块数
+static const size_t SLAB_POOLED[SLAB_CLASSES] = { 4096, 1024, 256 }; //每节点共享链表每级最多缓存的块数
+static const size_t MAX_SLAB = 65536;
+static const int MAX_IOV = 16; //WriteFd一次最多发送的块数
 
-//可写的数量（长度）
+//线程局部的空闲块链表：块可以在一个线程上分配、在另一个线程上归还，归还到当前线程的链表中
+//（分节点时只缓存与当前线程同节点的块）
+struct SlabCache {
+    std::vector<void*> free_[SLAB_CLASSES];
+    ~SlabCache();
+};
+
+//一个NUMA节点的共享空闲块链表：其他节点的线程归还的块放在这里，本节点的线程本地链表取空时批量取回
+struct NodePool {
+    std::mutex mtx_;
+    std::vector<void*> free_[SLAB_CLASSES];
+};
+
+static thread_local SlabCache* tlsCache = nullptr;
+static thread_local bool tlsCacheGone = false; //线程退出后（如全局对象析构时）直接使用全局分配器
+static NodePool* nodePools = nullptr; //进程生命周期内不释放，全局对象析构时仍可归还
+
+SlabCache::~SlabCache() {
+    for (auto& list : free_) {
+        for (void* p : list) ::operator delete(p);
+        list.clear();
+    }
+    tlsCache = nullptr;
+    tlsCacheGone = true;
+}
+
+static SlabCache* Cache() {
+    if (!tlsCache && !tlsCacheGone) {
+        static thread_local SlabCache cache;
+        tlsCache = &cache;
+    }
+    return tlsCache;
+}
+
+static int SlabClass(size_t len) {
+    for (size_t i = 0; i < SLAB_CLASSES; i++) {
+        if (len <= SLAB_SIZE[i]) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+std::atomic<size_t> Buffer::heldBytes_(0);
+int Buffer::numaNodes_ = 1;
+
+void Buffer::SetNumaNodes(int nodes) {
+    if (nodes <= 1 || nodePools) {
+        return;
+    }
+    nodePools = new NodePool[nodes];
+    numaNodes_ = nodes;
+}
+
+//当前线程的节点：不分池或线程没有绑定CPU时为-1
+static int SlabNode(int nodes) {
+    int node = nodes > 1 ? CpuPlacement::ThreadNode() : -1;
+    return node < nodes ? node : -1;
+}
+
+Buffer::Slab* Buffer::TakeSlab_(size_t len) {
+    int cls = SlabClass(len);
+    size_t cap = cls >= 0 ? SLAB_SIZE[cls] : len;
+    int node = SlabNode(numaNodes_);
+    void* mem = nullptr;
+    SlabCache* cache = Cache();
+    if (cls >= 0 && cache && cache->free_[cls].empty() && node >= 0) {
+        //本地链表空了，从本节点的共享链表取回一批（最多本地上限的一半）
+        NodePool& pool = nodePools[node];
+        std::lock_guard<std::mutex> locker(pool.mtx_);
+        std::vector<void*>& shared = pool.free_[cls];
+        size_t batch = std::min(shared.size(), SLAB_CACHED[cls] / 2);
+        cache->free_[cls].insert(cache->free_[cls].end(), shared.end() - batch, shared.end());
+        shared.resize(shared.size() - batch);
+    }
+    if (cls >= 0 && cache && !cache->free_[cls].empty()) {
+        mem = cache->free_[cls].back();
+        cache->free_[cls].pop_back();
+    } else {
+        mem = ::operator new(sizeof(Slab) + cap); //线程绑定CPU后内存策略优先本节点，新块落在本节点上
+    }
+    Slab* slab = static_cast<Slab*>(mem);
+    slab->cap = cap;
+    slab->read = slab->write = 0;
+    slab->node = node;
+    return slab;
+}
+
+void Buffer::GiveSlab_(Slab* slab) {
+    int cls = SlabClass(slab->cap);
+    if (cls < 0 || SLAB_SIZE[cls] != slab->cap) {
+        ::operator delete(slab);
+        return;
+    }
+    SlabCache* cache = Cache();
+    if (slab->node == SlabNode(numaNodes_)) {
+        if (cache && cache->free_[cls].size() < SLAB_CACHED[cls]) {
+            cache->free_[cls].push_back(slab);
+            return;
+        }
+    } else if (slab->node >= 0) {
+        //其他节点的块：放回所属节点，不进当前线程的链表
+        NodePool& pool = nodePools[slab->node];
+        std::lock_guard<std::mutex> locker(pool.mtx_);
+        if (pool.free_[cls].size() < SLAB_POOLED[cls]) {
+            pool.free_[cls].push_back(slab);
+            return;
+        }
+    }
+    ::operator delete(slab);
+}
+
+Buffer::Slab* Buffer::AllocSlab_(size_t len) {
+    Slab* slab = TakeSlab_(len);
+    heldBytes_.fetch_add(slab->cap, std::memory_order_relaxed);
+    return slab;
+}
+
+void Buffer::FreeSlab_(Slab* slab) {
+    heldBytes_.fetch_sub(slab->cap, std::memory_order_relaxed);
+    GiveSlab_(slab);
+}
+
+//不预先分配，第一次写入时才取块
+Buffer::Buffer(int initBufferSize): readable_(0), initSize_(initBufferSize > 0 ? initBufferSize : 1) {}
+
+Buffer::~Buffer() {
+    for (Slab* slab : chain_) {
+        FreeSlab_(slab);
+    }
+}
+
+//尾块中可写的数量（长度）
 size_t Buffer::WritableBytes() const {
-    return buffer_.size() - writeIndex_;
+    Slab* tail = Tail_();
+    return tail ? tail->cap - tail->write : 0;
 }
 //可读的数量（长度）
 size_t Buffer::ReadableBytes() const {
-    return writeIndex_ - readIndex_;
+    return readable_;
 }
 //可预留的空间（长度）
 size_t Buffer::PrependableBytes() const {
-    return readIndex_;
+    return chain_.empty() ? 0 : chain_.front()->read;
 }
 
+//数据跨块时合并到一个新块中，之后头块包含全部可读数据
+//新块留出与数据等量的空闲区：后续ReadFd先填满它才会再挂新块，反复Peek时复制总量与数据量成线性
+void Buffer::Linearize_() const {
+    if (chain_.empty()) {
+        return;
+    }
+    Slab* front = chain_.front();
+    if (front->write - front->read == readable_) {
+        return;
+    }
+    Slab* merged = AllocSlab_(readable_ * 2);
+    for (Slab* slab : chain_) {
+        memcpy(merged->Data() + merged->write, slab->Data() + slab->read, slab->write - slab->read);
+        merged->write += slab->write - slab->read;
+        FreeSlab_(slab);
+    }
+    chain_.clear();
+    chain_.push_back(merged);
+}
 
 const char* Buffer::Peek() const {
-    return &buffer_[readIndex_];
+    Linearize_();
+    if (chain_.empty()) {
+        return "";
+    }
+    Slab* front = chain_.front();
+    return front->Data() + front->read;
 }
 
+//保证尾块有len字节的连续空间：尾块放不下时挂上一个新块
 void Buffer::EnsureWritable(size_t len) {
-    if (Buffer::WritableBytes() < len) {
-        MakeSpace_(len);
+    Slab* tail = Tail_();
+    if (tail && tail->cap - tail->write >= len) {
+        return;
     }
+    if (tail && tail->read == tail->write) {
+        //尾块已经读空：从头复用，太小则换掉
+        tail->read = tail->write = 0;
+        if (tail->cap >= len) {
+            return;
+        }
+        chain_.pop_back();
+        FreeSlab_(tail);
+        tail = Tail_();
+    }
+    //新块比上一块大一级，数据量大时块数不会太多
+    size_t want = tail ? std::min(tail->cap * 4, MAX_SLAB) : initSize_;
+    chain_.push_back(AllocSlab_(std::max(want, len)));
     assert(len <= WritableBytes()); //再次验证，防御性编程
 }
 
-//写入len长度，修改writeIndex下标
+//写入len长度，修改尾块的写位置
 void Buffer::HasWritten(size_t len) {
-    writeIndex_ += len;
+    Slab* tail = Tail_();
+    assert(tail && tail->write + len <= tail->cap);
+    tail->write += len;
+    readable_ += len;
 }
 
-//读取len长度，修改readIndex下标
+//读取len长度，读空的块归还
 void Buffer::Retrieve(size_t len) {
-    if (len < ReadableBytes()) {
-        readIndex_ += len;
-    } else {
+    if (len >= readable_) {
         RetrieveAll();
+        return;
     }
+    readable_ -= len;
+    size_t drop = 0; //读空的头部块数（后面还有数据，不会是最后一块）
+    while (true) {
+        Slab* front = chain_[drop];
+        size_t avail = front->write - front->read;
+        if (len < avail) {
+            front->read += len;
+            break;
+        }
+        len -= avail;
+        FreeSlab_(front);
+        drop++;
+    }
+    chain_.erase(chain_.begin(), chain_.begin() + drop);
 }
 
 //读取数据到end为止
@@ -51,35 +245,73 @@ void Buffer::RetrieveUntil(const char* end) {
 }
 
 void Buffer::RetrieveAll() {
-    //bzero 是 C 语言中的函数，作用是将一块内存的所有字节清零
-    //但是比较耗时实际上，只重置指针就能 “逻辑上清空数据”
-    //后续写入会覆盖旧数据，无需真正清零内存
-    // bzero(&buffer_[0], buffer_.size());
-    // 重置读写指针到起始位置，避免保留前置空洞
-    readIndex_ = 0;
-    writeIndex_ = 0;
+    //保留头块并重置读写位置，后续写入直接复用，不需要清零内存
+    //其余块归还给空闲链表
+    while (chain_.size() > 1) {
+        FreeSlab_(chain_.back());
+        chain_.pop_back();
+    }
+    if (!chain_.empty()) {
+        Slab* front = chain_.front();
+        if (front->cap > MAX_SLAB) {
+            FreeSlab_(front); //合并出来的大块不保留
+            chain_.clear();
+        } else {
+            front->read = front->write = 0;
+        }
+    }
+    readable_ = 0;
+}
+
+void Buffer::Release() {
+    assert(readable_ == 0);
+    for (Slab* slab : chain_) {
+        FreeSlab_(slab);
+    }
+    std::vector<Slab*>().swap(chain_); //链本身的内存也一并释放
+    readable_ = 0;
 }
 
 std::string Buffer::RetrieveAllToStr() {
-    std::string str(Peek(), ReadableBytes());
+    std::string str;
+    str.reserve(readable_);
+    for (Slab* slab : chain_) {
+        str.append(slab->Data() + slab->read, slab->write - slab->read);
+    }
     RetrieveAll();
     return str;
 }
 
 const char* Buffer::BeginWriteConst() const {
-    return &buffer_[writeIndex_];
+    Linearize_();
+    if (chain_.empty()) {
+        return "";
+    }
+    Slab* front = chain_.front();
+    return front->Data() + front->write;
 }
 
 char* Buffer::BeginWrite() {
-    return &buffer_[writeIndex_];
+    if (WritableBytes() == 0) {
+        EnsureWritable(1);
+    }
+    Slab* tail = Tail_();
+    return tail->Data() + tail->write;
 }
 
+//先填满尾块，剩余部分放进一个足够大的新块
 void Buffer::Append(const char* str, size_t len) {
     assert(str);
-    EnsureWritable(len);
-    //将str复制到write空间，注意copy的使用方法
-    std::copy(str,str+len,BeginWrite()); 
-    HasWritten(len);
+    size_t n = std::min(len, WritableBytes());
+    if (n > 0) {
+        memcpy(BeginWrite(), str, n);
+        HasWritten(n);
+    }
+    if (len > n) {
+        EnsureWritable(len - n);
+        memcpy(BeginWrite(), str + n, len - n);
+        HasWritten(len - n);
+    }
 }
 void Buffer::Append(const std::string& str) {
     Append(str.c_str(), str.size());
@@ -88,54 +320,87 @@ void Buffer::Append(const void* data, size_t len) {
     Append(static_cast<const char*>(data), len);
 }
 void Buffer::Append(const Buffer& buff) {
-    Append(buff.Peek(), buff.ReadableBytes());
+    for (Slab* slab : buff.chain_) {
+        if (slab->write > slab->read) {
+            Append(slab->Data() + slab->read, slab->write - slab->read);
+        }
+    }
 }
 
-//接下来用到的write和readv都是linux系统的系统调用，在<unistd.h>和<sys/uio.h>头文件中 
+//接下来用到的writev和readv都是linux系统的系统调用，在<unistd.h>和<sys/uio.h>头文件中
 
 //从文件描述符读取数据
 ssize_t Buffer::ReadFd(int fd, int* Errno) {
-    //栈上临时缓冲区，
-    char buff[65545];
-    //分散读（scatter-gather I/O）的缓冲区结构
-    //iovec结构体包含两个成员：iov_base（缓冲区基地址）和iov_len（缓冲区长度）
-    //第一个是Buffer自身的区域
-    //第二个是buff临时缓冲区
+    //分散读（scatter-gather I/O）：先填尾块的空闲区，放不下的读入一个新的64KB块
+    //新块从空闲链表中取，没有用到时原样归还
+    if (WritableBytes() == 0) {
+        EnsureWritable(1);
+    }
+    Slab* tail = Tail_();
+    Slab* spare = TakeSlab_(MAX_SLAB);
     struct iovec iov[2];
-    size_t writeable = WritableBytes();
-    iov[0].iov_base = BeginWrite();
+    size_t writeable = tail->cap - tail->write;
+    iov[0].iov_base = tail->Data() + tail->write;
     iov[0].iov_len = writeable;
-    iov[1].iov_base = buff;
-    iov[1].iov_len = sizeof(buff);
+    iov[1].iov_base = spare->Data();
+    iov[1].iov_len = spare->cap;
 
-    //readv 是 Linux 提供的 “分散读” 系统调用
-    //功能是：从 fd 读取数据，先填满 iov[0]（直到 iov[0].iov_len）
-    //剩余数据再填满 iov[1]（直到 iov[1].iov_len）
-    //返回值 len 是实际读取的总字节数（若失败则为 -1）
     ssize_t len = readv(fd, iov, 2);
     if (len < 0) {
         //将系统调用失败的错误码（errno）保存到外部传入的Errno指针指向的变量中
-        *Errno = errno; //errno 是C/C++标准库中定义的全局错误码变量
+        *Errno = errno;
+        GiveSlab_(spare);
     } else if (static_cast<size_t>(len) <= writeable) {
-        //数据完全放入 Buffer 的情况
-        writeIndex_ += len;
+        //数据完全放入尾块
+        tail->write += len;
+        readable_ += len;
+        GiveSlab_(spare);
     } else {
-        //数据部分放入临时缓冲区的情况
-        writeIndex_ = buffer_.size();
-        //将临时缓冲区中剩余的数据追加到Buffer中
-        Append(buff, static_cast<size_t>(len-writeable));
+        //多出的数据已经在新块中，直接挂到链尾
+        tail->write = tail->cap;
+        spare->write = static_cast<size_t>(len) - writeable;
+        heldBytes_.fetch_add(spare->cap, std::memory_order_relaxed);
+        chain_.push_back(spare);
+        readable_ += len;
     }
     return len;
 }
 
-//向文件描述符（通常是网络 socket）写入数据
+//把可读区中[offset, offset+len)按块映射成iovec，不合并数据
+int Buffer::PeekIov(size_t offset, size_t len, struct iovec* iov, int maxIov) const {
+    assert(offset + len <= readable_);
+    int cnt = 0;
+    for (size_t i = 0; i < chain_.size() && len > 0 && cnt < maxIov; i++) {
+        Slab* slab = chain_[i];
+        size_t n = slab->write - slab->read;
+        if (offset >= n) {
+            offset -= n;
+            continue;
+        }
+        //一段数据跨块时拆成多个iovec；iov用完时只覆盖前半段，sendmsg照样能发
+        size_t take = std::min(n - offset, len);
+        iov[cnt].iov_base = slab->Data() + slab->read + offset;
+        iov[cnt].iov_len = take;
+        cnt++;
+        len -= take;
+        offset = 0;
+    }
+    return cnt;
+}
+
+//向文件描述符（通常是网络 socket）写入数据：整条链一次 writev
 ssize_t Buffer::WriteFd(int fd, int* Errno) {
-    //write 是系统调用，功能是将数据从用户空间写入内核空间
-    //fd：目标文件描述符（如 socket）。
-    //Peek()：返回缓冲区可读数据的起始地址（const char*），即要发送的数据的起始位置。
-    //ReadableBytes()：返回可读数据的长度（size_t），即要发送的数据总字节数
-    //返回值 len：实际写入的字节数
-    ssize_t len = write(fd, Peek(), ReadableBytes());
+    struct iovec iov[MAX_IOV];
+    int cnt = 0;
+    for (size_t i = 0; i < chain_.size() && cnt < MAX_IOV; i++) {
+        Slab* slab = chain_[i];
+        if (slab->write > slab->read) {
+            iov[cnt].iov_base = slab->Data() + slab->read;
+            iov[cnt].iov_len = slab->write - slab->read;
+            cnt++;
+        }
+    }
+    ssize_t len = writev(fd, iov, cnt);
     if (len < 0) {
         *Errno = errno;
         return len;
@@ -143,31 +408,3 @@ ssize_t Buffer::WriteFd(int fd, int* Errno) {
     Retrieve(len);
     return len;
 }
-
-char* Buffer::BeginPtr_() {
-    return &buffer_[0];
-}
-
-const char* Buffer::BeginPtr_() const{
-    return &buffer_[0];
-}
-
-//空间扩容
-void Buffer::MakeSpace_(size_t len) {
-    if (WritableBytes() + PrependableBytes() < len) {
-        //加上前置空间也不够时，直接扩容
-        //buffer底层是vector，所以直接resize，额外 +1 通常是预留一个字节，避免边界问题
-        buffer_.resize(writeIndex_ + len + 1);
-    } else {
-        //空间充足时，移动数据回收前置区域
-        size_t readable = ReadableBytes(); //有效数据的长度
-        //将有效数据从[readIndex_, writeIndex_)移动到缓冲区起始位置[0, readable)
-        std::copy(BeginPtr_()+readIndex_, BeginPtr_()+writeIndex_,BeginPtr_());
-        //重置读写指针
-        readIndex_ = 0;
-        writeIndex_ = readable;
-        assert(readable == ReadableBytes());
-    }
-}
-
-
@@ -10,10 +10,23 @@
 #include <atomic>
 #include <assert.h>
 
+/*
+链式缓冲区：数据保存在一串定长的内存块（slab）中，块大小分 4KB/16KB/64KB 三级，
+从线程局部的空闲链表中分配，用完归还，不再像 vector 那样扩容时清零、搬移数据。
+- ReadFd：readv 直接读入尾块的空闲区和一个新块，数据多出来时新块挂到链尾，不经过栈上的临时数组；
+- WriteFd：整条链组成 iovec 一次 writev 发出；
+- PeekIov：按偏移把一段可读数据映射成 iovec，供调用方自己拼 sendmsg，同样不合并；
+- Peek/BeginWriteConst：调用方需要连续内存时才把数据合并到一个块中（请求跨块时才会发生）。
+多NUMA节点时（SetNumaNodes）每个块记录分配它的线程所在的节点，线程局部链表只缓存本节点的块，
+在其他节点上归还的块放回所属节点的共享链表，由该节点的线程批量取回，连接缓冲区始终使用服务它的节点的内存。
+缓冲区只属于一个连接（同一时刻只有一个线程访问），读写位置不需要原子变量。
+*/
 class Buffer {
 public:
     Buffer(int initBufferSize  = 1024);
-    ~Buffer() = default;
+    ~Buffer();
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
 
     size_t WritableBytes() const; //获取三个空间的大小
     size_t ReadableBytes() const;
@@ -28,8 +41,8 @@ public:
     void RetrieveAll();
     std::string RetrieveAllToStr();
 
-    const char* BeginWriteConst() const; //writeindex，只能得到位置
-    char* BeginWrite(); //也是writeindex
+    const char* BeginWriteConst() const; //可读数据的末尾，只能得到位置
+    char* BeginWrite(); //尾块的写位置
 
     void Append(const std::string& str); //写入函数
     void Append(const char* str, size_t len); //C风格的字符串
@@ -38,20 +51,41 @@ public:
 
     ssize_t ReadFd(int fd, int* Errno); //从fd中读取数据到缓冲区
     ssize_t WriteFd(int fd, int* Errno); //将缓冲区数据写入到fd
+    int PeekIov(size_t offset, size_t len, struct iovec* iov, int maxIov) const; //可读区[offset, offset+len)填入iov，返回用掉的个数
+
+    //连接空闲时把所有块归还给空闲链表（缓冲区必须已读空），下次写入时重新取块
+    void Release();
+    //所有缓冲区当前持有的块的总字节数（不含空闲链表中缓存的块），用于内存预算
+    static size_t HeldBytes() { return heldBytes_.load(std::memory_order_relaxed); }
+    //按NUMA节点分池（nodes <= 1 关闭），在启动其他线程前调用一次
+    static void SetNumaNodes(int nodes);
+    static int NumaNodes() { return numaNodes_; }
 
 private:
-    char* BeginPtr_(); //Buffer头指针,获取缓冲区底层内存的起始地址
-    const char* BeginPtr_() const; //Buffer头指针,用于只读访问缓冲区数据。
-    void MakeSpace_(size_t len); //扩容函数
-
-    std::vector<char> buffer_; //缓冲区
-    //atomic是原子操作类型，用于实现多线程环境下的无锁同步
-    //能保证对变量的读写操作是 “原子性” 的 —— 即操作不会被线程调度机制打断
-    //要么完全执行，要么完全不执行
-    //从而避免多线程并发访问时的数据竞争（Data Race）问题
-    std::atomic<size_t> readIndex_; //读索引
-    std::atomic<size_t> writeIndex_; //写索引
+    //内存块：块头后面紧跟 cap 字节的数据区，[read, write) 为可读数据
+    struct Slab {
+        size_t cap;
+        size_t read;
+        size_t write;
+        int node; //分配时所在的NUMA节点，不分池时为-1
+        char* Data() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+    static Slab* AllocSlab_(size_t len); //取一个容量不小于len的块，计入HeldBytes
+    static void FreeSlab_(Slab* slab);
+    static Slab* TakeSlab_(size_t len); //只从空闲链表取/还，不计入HeldBytes
+    static void GiveSlab_(Slab* slab);
+
+    Slab* Tail_() const { return chain_.empty() ? nullptr : chain_.back(); }
+    void Linearize_() const; //把可读数据合并到一个块中
+
+    //数据块链，头块最先被读取；链通常只有一两个块，用vector即可；Peek需要合并数据，所以是mutable
+    mutable std::vector<Slab*> chain_;
+    mutable size_t readable_; //所有块中可读数据的总长度
+    size_t initSize_; //第一个块的大小
 
+    static std::atomic<size_t> heldBytes_;
+    static int numaNodes_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,251 @@
+#include "charscan.h"
+#include <string.h>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHARSCAN_X86
+#include <immintrin.h>
+#endif
+
+//逐字节实现：所有平台可用，也用于处理SIMD实现剩下的不足一个块的尾部
+static const char* CrlfScalar(const char* p, const char* end) {
+    while (p < end) {
+        const char* cr = static_cast<const char*>(memchr(p, '\r', end - p));
+        if (!cr || cr + 1 >= end) {
+            return end;
+        }
+        if (cr[1] == '\n') {
+            return cr;
+        }
+        p = cr + 1;
+    }
+    return end;
+}
+
+static const char* HeadEndScalar(const char* p, const char* end) {
+    while (p < end) {
+        const char* cr = static_cast<const char*>(memchr(p, '\r', end - p));
+        if (!cr || end - cr < 4) {
+            return end;
+        }
+        if (memcmp(cr, "\r\n\r\n", 4) == 0) {
+            return cr;
+        }
+        p = cr + 1;
+    }
+    return end;
+}
+
+static inline bool IsCtl(char c) {
+    unsigned char u = static_cast<unsigned char>(c);
+    return (u < 0x20 && u != '\t') || u == 0x7f;
+}
+
+static const char* CtlScalar(const char* p, const char* end) {
+    while (p < end && !IsCtl(*p)) p++;
+    return p;
+}
+
+static const char* FormScalar(const char* p, const char* end) {
+    while (p < end && *p != '=' && *p != '&' && *p != '+' && *p != '%') p++;
+    return p;
+}
+
+#ifdef CHARSCAN_X86
+//SSE2：每次比较16字节，匹配位通过movemask转成整数，最低的置位即第一个匹配
+//多字节的模式（"\r\n"、"\r\n\r\n"）用错开1~3字节的几次加载分别比较后相与
+static const char* CrlfSse2(const char* p, const char* end) {
+    const __m128i cr = _mm_set1_epi8('\r'), lf = _mm_set1_epi8('\n');
+    for (; end - p >= 17; p += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return CrlfScalar(p, end);
+}
+
+static const char* HeadEndSse2(const char* p, const char* end) {
+    const __m128i cr = _mm_set1_epi8('\r'), lf = _mm_set1_epi8('\n');
+    for (; end - p >= 19; p += 16) {
+        __m128i m = _mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), cr),
+                          _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1)), lf)),
+            _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2)), cr),
+                          _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 3)), lf)));
+        unsigned mask = _mm_movemask_epi8(m);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return HeadEndScalar(p, end);
+}
+
+//SSE2没有无符号比较：异或0x80后按有符号比较，x < 0x20 等价于 (x^0x80) < (0x20^0x80)
+static const char* CtlSse2(const char* p, const char* end) {
+    const __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(0x20 ^ 0x80));
+    const __m128i tab = _mm_set1_epi8('\t'), del = _mm_set1_epi8(0x7f);
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i low = _mm_andnot_si128(_mm_cmpeq_epi8(x, tab), _mm_cmplt_epi8(_mm_xor_si128(x, flip), limit));
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(low, _mm_cmpeq_epi8(x, del)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return CtlScalar(p, end);
+}
+
+//表单里的分隔符很密（每个键、值通常只有几个字节），先逐字节看一小段，命中时省掉向量常量的准备
+static const size_t FORM_PROBE = 8;
+
+static const char* FormSse2(const char* p, const char* end) {
+    const char* probe = FormScalar(p, p + std::min(FORM_PROBE, static_cast<size_t>(end - p)));
+    if (probe < end && probe < p + FORM_PROBE) {
+        return probe;
+    }
+    p = probe;
+    const __m128i eq = _mm_set1_epi8('='), amp = _mm_set1_epi8('&');
+    const __m128i plus = _mm_set1_epi8('+'), pct = _mm_set1_epi8('%');
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, eq), _mm_cmpeq_epi8(x, amp)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(x, plus), _mm_cmpeq_epi8(x, pct)));
+        unsigned mask = _mm_movemask_epi8(m);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return FormScalar(p, end);
+}
+
+//AVX2：同样的算法，每次32字节；函数单独按avx2编译，整个程序不需要-mavx2
+//尾部交给SSE2实现（非VEX编码），之前必须清掉ymm高半部分，否则每条SSE指令都要付出状态切换的代价
+//（编译器把这里优化成尾调用时不会自动插入vzeroupper）
+#define AVX2_FN __attribute__((target("avx2")))
+
+AVX2_FN static const char* CrlfAvx2(const char* p, const char* end) {
+    const __m256i cr = _mm256_set1_epi8('\r'), lf = _mm256_set1_epi8('\n');
+    for (; end - p >= 33; p += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, cr), _mm256_cmpeq_epi8(b, lf)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return CrlfSse2(p, end);
+}
+
+AVX2_FN static const char* HeadEndAvx2(const char* p, const char* end) {
+    const __m256i cr = _mm256_set1_epi8('\r'), lf = _mm256_set1_epi8('\n');
+    for (; end - p >= 35; p += 32) {
+        __m256i m = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), cr),
+                             _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1)), lf)),
+            _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 2)), cr),
+                             _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 3)), lf)));
+        unsigned mask = _mm256_movemask_epi8(m);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return HeadEndSse2(p, end);
+}
+
+AVX2_FN static const char* CtlAvx2(const char* p, const char* end) {
+    const __m256i flip = _mm256_set1_epi8(static_cast<char>(0x80));
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(0x20 ^ 0x80));
+    const __m256i tab = _mm256_set1_epi8('\t'), del = _mm256_set1_epi8(0x7f);
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i low = _mm256_andnot_si256(_mm256_cmpeq_epi8(x, tab),
+                                          _mm256_cmpgt_epi8(limit, _mm256_xor_si256(x, flip)));
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(low, _mm256_cmpeq_epi8(x, del)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return CtlSse2(p, end);
+}
+
+AVX2_FN static const char* FormAvx2(const char* p, const char* end) {
+    const char* probe = FormScalar(p, p + std::min(FORM_PROBE, static_cast<size_t>(end - p)));
+    if (probe < end && probe < p + FORM_PROBE) {
+        return probe;
+    }
+    p = probe;
+    const __m256i eq = _mm256_set1_epi8('='), amp = _mm256_set1_epi8('&');
+    const __m256i plus = _mm256_set1_epi8('+'), pct = _mm256_set1_epi8('%');
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, eq), _mm256_cmpeq_epi8(x, amp)),
+                                    _mm256_or_si256(_mm256_cmpeq_epi8(x, plus), _mm256_cmpeq_epi8(x, pct)));
+        unsigned mask = _mm256_movemask_epi8(m);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return FormSse2(p, end);
+}
+
+#undef AVX2_FN
+#endif
+
+const CharScan::Ops CharScan::TABLE[ISA_COUNT] = {
+    { CrlfScalar, HeadEndScalar, CtlScalar, FormScalar },
+#ifdef CHARSCAN_X86
+    { CrlfSse2, HeadEndSse2, CtlSse2, FormSse2 },
+    { CrlfAvx2, HeadEndAvx2, CtlAvx2, FormAvx2 },
+#else
+    { CrlfScalar, HeadEndScalar, CtlScalar, FormScalar },
+    { CrlfScalar, HeadEndScalar, CtlScalar, FormScalar },
+#endif
+};
+
+CharScan::ISA CharScan::active_ = CharScan::Detect_();
+const CharScan::Ops* CharScan::ops_ = &CharScan::TABLE[CharScan::active_];
+
+bool CharScan::Supported(ISA isa) {
+    switch (isa) {
+        case ISA_SCALAR:
+            return true;
+#ifdef CHARSCAN_X86
+        case ISA_SSE2:
+            __builtin_cpu_init(); //静态初始化阶段调用时，CPU信息可能还没有读取
+            return __builtin_cpu_supports("sse2");
+        case ISA_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+CharScan::ISA CharScan::Detect_() {
+    if (Supported(ISA_AVX2)) return ISA_AVX2;
+    if (Supported(ISA_SSE2)) return ISA_SSE2;
+    return ISA_SCALAR;
+}
+
+bool CharScan::Use(ISA isa) {
+    if (isa < 0 || isa >= ISA_COUNT || !Supported(isa)) {
+        return false;
+    }
+    active_ = isa;
+    ops_ = &TABLE[isa];
+    return true;
+}
+
+const char* CharScan::IsaName(ISA isa) {
+    static const char* NAME[ISA_COUNT] = { "scalar", "sse2", "avx2" };
+    return isa >= 0 && isa < ISA_COUNT ? NAME[isa] : "unknown";
+}
@@ -0,0 +1,49 @@
+/*
+请求解析用的字节扫描：在读缓冲区上原地查找分隔符，一次比较16/32个字节。
+- FindCrlf：下一个"\r\n"（请求头按行切分）；
+- FindHeadEnd：第一个"\r\n\r\n"（请求头结束）；
+- FindCtl：第一个不允许出现在字段值中的控制字符（HTAB以外的0x00-0x1f和0x7f）；
+- FindFormDelim：第一个'='、'&'、'+'或'%'（表单请求体切分）。
+启动时按CPUID选择AVX2、SSE2或逐字节的实现，非x86平台只有逐字节实现。
+所有函数在没有找到时返回end。
+*/
+
+#ifndef CHARSCAN_H
+#define CHARSCAN_H
+
+#include <stddef.h>
+
+class CharScan {
+public:
+    enum ISA {
+        ISA_SCALAR = 0,
+        ISA_SSE2,
+        ISA_AVX2,
+        ISA_COUNT,
+    };
+
+    static const char* FindCrlf(const char* begin, const char* end) { return Ops_().crlf(begin, end); }
+    static const char* FindHeadEnd(const char* begin, const char* end) { return Ops_().headEnd(begin, end); }
+    static const char* FindCtl(const char* begin, const char* end) { return Ops_().ctl(begin, end); }
+    static const char* FindFormDelim(const char* begin, const char* end) { return Ops_().form(begin, end); }
+
+    static ISA Active() { return active_; }
+    static const char* IsaName(ISA isa);
+    static bool Supported(ISA isa); //当前CPU是否支持
+    static bool Use(ISA isa); //切换实现（基准测试对比用），CPU不支持时返回false且不切换
+
+private:
+    typedef const char* (*ScanFn)(const char*, const char*);
+    struct Ops {
+        ScanFn crlf, headEnd, ctl, form;
+    };
+
+    static const Ops& Ops_() { return *ops_; }
+    static ISA Detect_(); //支持的最快实现
+
+    static const Ops TABLE[ISA_COUNT];
+    static ISA active_;
+    static const Ops* ops_;
+};
+
+#endif
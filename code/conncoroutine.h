@@ -0,0 +1,111 @@
+/*
+C++20 协程模式（CMake 选项 USE_COROUTINE，定义 WEBSERVER_COROUTINE 时才编译）：
+每个连接由一个协程驱动，读 -> 解析 -> 发送 写成顺序代码，
+等待可读/可写时挂起，由事件循环收到事件后直接恢复，不经过线程池；
+需要访问数据库等阻塞操作时切换到线程池执行，完成后再切回事件循环。
+协程帧从线程局部的空闲链表中分配，连接反复建立/关闭时不再触碰全局分配器。
+*/
+
+#ifndef CONNCOROUTINE_H
+#define CONNCOROUTINE_H
+
+#ifdef WEBSERVER_COROUTINE
+
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <vector>
+#include <stddef.h>
+
+//协程帧分配器：按64字节对齐的大小分级，每个线程一组空闲链表
+//在一个线程上分配、另一个线程上释放时，内存归还到释放线程的链表，不需要加锁
+class FramePool {
+public:
+    static void* Alloc(size_t size) {
+        size_t cls = Class_(size);
+        if (cls >= CLASSES) {
+            return ::operator new(size);
+        }
+        std::vector<void*>& list = Lists_()[cls];
+        if (!list.empty()) {
+            void* p = list.back();
+            list.pop_back();
+            return p;
+        }
+        return ::operator new((cls + 1) * GRANULE);
+    }
+
+    static void Free(void* p, size_t size) {
+        size_t cls = Class_(size);
+        if (cls >= CLASSES) {
+            ::operator delete(p);
+            return;
+        }
+        std::vector<void*>& list = Lists_()[cls];
+        if (list.size() >= MAX_CACHED) {
+            ::operator delete(p);
+            return;
+        }
+        list.push_back(p);
+    }
+
+private:
+    static const size_t GRANULE = 64;
+    static const size_t CLASSES = 64; //最大缓存 4KB 的帧
+    static const size_t MAX_CACHED = 4096; //每个大小级别每线程最多缓存的帧数
+
+    static size_t Class_(size_t size) { return (size + GRANULE - 1) / GRANULE - 1; }
+
+    struct Lists {
+        std::vector<void*> lists_[CLASSES];
+        std::vector<void*>& operator[](size_t i) { return lists_[i]; }
+        ~Lists() {
+            for (auto& l : lists_) {
+                for (void* p : l) ::operator delete(p);
+            }
+        }
+    };
+    static Lists& Lists_() {
+        static thread_local Lists lists;
+        return lists;
+    }
+};
+
+//连接协程：创建后先挂起，由事件循环第一次恢复；结束时也挂起，由事件循环回收
+class ConnCoroutine {
+public:
+    struct promise_type {
+        ConnCoroutine get_return_object() {
+            return ConnCoroutine(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(size_t size) { return FramePool::Alloc(size); }
+        static void operator delete(void* p, size_t size) { FramePool::Free(p, size); }
+    };
+
+    explicit ConnCoroutine(std::coroutine_handle<promise_type> h) : handle_(h) {}
+    ConnCoroutine(ConnCoroutine&& other) noexcept : handle_(other.handle_) { other.handle_ = nullptr; }
+    ConnCoroutine(const ConnCoroutine&) = delete;
+    ConnCoroutine& operator=(const ConnCoroutine&) = delete;
+    ~ConnCoroutine() {
+        if (handle_) handle_.destroy();
+    }
+
+    //交出句柄，之后由调用方负责 destroy
+    std::coroutine_handle<> Release() {
+        std::coroutine_handle<> h = handle_;
+        handle_ = nullptr;
+        return h;
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+#endif //WEBSERVER_COROUTINE
+
+#endif
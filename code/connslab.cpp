@@ -0,0 +1,65 @@
+#include "connslab.h"
+
+ConnSlab::ConnSlab(size_t capacity) : capacity_(capacity), slots_(new Slot[capacity]) {
+    assert(capacity > 0);
+    for (size_t i = 0; i < capacity_; i++) {
+        slots_[i].tag_.store(0, std::memory_order_relaxed);
+        slots_[i].conn_ = nullptr;
+    }
+}
+
+ConnSlab::~ConnSlab() {
+    for (size_t i = 0; i < capacity_; i++) {
+        delete slots_[i].conn_; //HttpConn析构时会关闭仍打开的连接
+    }
+}
+
+size_t ConnSlab::DefaultCapacity(size_t maxFd) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY
+            && static_cast<size_t>(rl.rlim_cur) < maxFd) {
+        return static_cast<size_t>(rl.rlim_cur);
+    }
+    return maxFd;
+}
+
+HttpConn* ConnSlab::Alloc(int fd, uint32_t* gen) {
+    if (fd < 0 || static_cast<size_t>(fd) >= capacity_) {
+        return nullptr;
+    }
+    Slot& slot = slots_[fd];
+    if (!slot.conn_) {
+        slot.conn_ = new HttpConn(); //该fd第一次出现时创建，之后一直复用
+    }
+    uint32_t g = (slot.tag_.load(std::memory_order_relaxed) >> 1) + 1;
+    //release：其他线程通过acquire读到新代数时，一定能看到conn_
+    slot.tag_.store((g << 1) | 1, std::memory_order_release);
+    if (gen) *gen = g;
+    return slot.conn_;
+}
+
+void ConnSlab::Free(int fd) {
+    assert(fd >= 0 && static_cast<size_t>(fd) < capacity_);
+    slots_[fd].tag_.fetch_and(~1u, std::memory_order_release);
+}
+
+HttpConn* ConnSlab::Get(int fd) const {
+    if (fd < 0 || static_cast<size_t>(fd) >= capacity_) {
+        return nullptr;
+    }
+    const Slot& slot = slots_[fd];
+    return (slot.tag_.load(std::memory_order_acquire) & 1) ? slot.conn_ : nullptr;
+}
+
+HttpConn* ConnSlab::Get(int fd, uint32_t gen) const {
+    if (fd < 0 || static_cast<size_t>(fd) >= capacity_) {
+        return nullptr;
+    }
+    const Slot& slot = slots_[fd];
+    return slot.tag_.load(std::memory_order_acquire) == ((gen << 1) | 1) ? slot.conn_ : nullptr;
+}
+
+uint32_t ConnSlab::Gen(int fd) const {
+    assert(fd >= 0 && static_cast<size_t>(fd) < capacity_);
+    return slots_[fd].tag_.load(std::memory_order_acquire) >> 1;
+}
@@ -0,0 +1,54 @@
+/*
+按fd下标索引的连接表（替代 unordered_map<int, HttpConn>）：
+热数据（代数+使用标记、连接指针）放在连续的槽数组里，事件分发只需一次数组下标访问；
+冷数据（HttpConn对象：地址、缓冲区、请求/响应）在某个fd第一次使用时创建，之后随fd复用，
+因此稳定运行后accept/close不再触碰内存分配器。
+每个槽带一个代数，每次分配递增，投递给线程池的任务记录(fd, 代数)，
+执行时代数不一致说明fd已被关闭或复用，任务直接丢弃。
+*/
+
+#ifndef CONNSLAB_H
+#define CONNSLAB_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <assert.h>
+#include <sys/resource.h>
+
+#include "httpconn.h"
+
+class ConnSlab {
+public:
+    explicit ConnSlab(size_t capacity);
+    ~ConnSlab();
+
+    //容量取 RLIMIT_NOFILE 与 maxFd 中较小者（超出进程fd上限的槽永远用不到）
+    static size_t DefaultCapacity(size_t maxFd);
+
+    size_t Capacity() const { return capacity_; }
+
+    //为fd分配槽位，返回对应的连接对象，gen输出本次分配的代数；fd超出容量时返回nullptr
+    HttpConn* Alloc(int fd, uint32_t* gen);
+    //释放fd的槽位（对象保留，供该fd下次复用）
+    void Free(int fd);
+
+    //查找正在使用的连接，不存在返回nullptr
+    HttpConn* Get(int fd) const;
+    //按(fd, 代数)查找，代数不一致（过期任务）返回nullptr
+    HttpConn* Get(int fd, uint32_t gen) const;
+    //fd当前的代数
+    uint32_t Gen(int fd) const;
+
+private:
+    //槽：tag_ = 代数 << 1 | 使用标记
+    struct Slot {
+        std::atomic<uint32_t> tag_;
+        HttpConn* conn_;
+    };
+
+    size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+};
+
+#endif
@@ -0,0 +1,213 @@
+#include "cpuplacement.h"
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <algorithm>
+#include <map>
+using namespace std;
+
+thread_local int CpuPlacement::threadNode_ = -1;
+
+//读取 sysfs 中的整数，失败时返回 def
+static int ReadSysInt(const char* path, int def) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return def;
+    int val = def;
+    if (fscanf(fp, "%d", &val) != 1) val = def;
+    fclose(fp);
+    return val;
+}
+
+CpuPlacement::CpuPlacement() : policy_(POLICY_NONE), logCpu_(-1), nodeCount_(1) {}
+
+void CpuPlacement::LoadTopology_() {
+    cpus_.clear();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return;
+    }
+    char path[128];
+    int maxNode = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &set)) continue;
+        CpuInfo info;
+        info.cpu = cpu;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        info.package = ReadSysInt(path, 0);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        info.core = ReadSysInt(path, cpu);
+        //所属NUMA节点：cpuN 目录下的 nodeX 链接
+        info.node = 0;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+        DIR* dir = opendir(path);
+        if (dir) {
+            struct dirent* ent;
+            while ((ent = readdir(dir)) != nullptr) {
+                if (strncmp(ent->d_name, "node", 4) == 0 && ent->d_name[4] >= '0' && ent->d_name[4] <= '9') {
+                    info.node = atoi(ent->d_name + 4);
+                    break;
+                }
+            }
+            closedir(dir);
+        }
+        maxNode = max(maxNode, info.node);
+        info.sibling = 0;
+        for (const CpuInfo& c : cpus_) {
+            if (c.package == info.package && c.core == info.core) info.sibling++;
+        }
+        cpus_.push_back(info);
+    }
+    nodeCount_ = maxNode + 1;
+}
+
+bool CpuPlacement::ParseList_(const char* spec, vector<int>* cpus) const {
+    const char* p = spec;
+    while (*p) {
+        char* end;
+        long lo = strtol(p, &end, 10);
+        if (end == p || lo < 0) return false;
+        long hi = lo;
+        p = end;
+        if (*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            if (end == p + 1 || hi < lo) return false;
+            p = end;
+        }
+        for (long c = lo; c <= hi; c++) {
+            if (Find_(static_cast<int>(c))) {
+                cpus->push_back(static_cast<int>(c)); //不允许使用的CPU直接跳过
+            }
+        }
+        if (*p == ',') p++;
+        else if (*p) return false;
+    }
+    return true;
+}
+
+const CpuPlacement::CpuInfo* CpuPlacement::Find_(int cpu) const {
+    for (const CpuInfo& c : cpus_) {
+        if (c.cpu == cpu) return &c;
+    }
+    return nullptr;
+}
+
+bool CpuPlacement::Init(const char* spec, int logCpu) {
+    policy_ = POLICY_NONE;
+    order_.clear();
+    logCpu_ = -1;
+    LoadTopology_();
+    if (cpus_.empty()) {
+        return false;
+    }
+    if (logCpu >= 0 && Find_(logCpu)) {
+        logCpu_ = logCpu;
+    }
+    if (!spec || !*spec || strcmp(spec, "none") == 0) {
+        return logCpu < 0 || logCpu_ >= 0;
+    }
+
+    vector<CpuInfo> cpus;
+    for (const CpuInfo& c : cpus_) {
+        if (c.cpu != logCpu_) cpus.push_back(c);
+    }
+    if (cpus.empty()) {
+        cpus = cpus_; //只有一个CPU时日志线程只能与其他线程共用
+    }
+
+    if (strcmp(spec, "compact") == 0) {
+        policy_ = POLICY_COMPACT;
+        sort(cpus.begin(), cpus.end(), [](const CpuInfo& a, const CpuInfo& b) {
+            if (a.node != b.node) return a.node < b.node;
+            if (a.package != b.package) return a.package < b.package;
+            if (a.core != b.core) return a.core < b.core;
+            return a.cpu < b.cpu;
+        });
+        for (const CpuInfo& c : cpus) order_.push_back(c.cpu);
+    } else if (strcmp(spec, "spread") == 0) {
+        policy_ = POLICY_SPREAD;
+        //每个节点内先排各物理核的第一个超线程，再排第二个……；然后各节点轮流取
+        map<int, vector<CpuInfo>> byNode;
+        for (const CpuInfo& c : cpus) byNode[c.node].push_back(c);
+        size_t longest = 0;
+        for (auto& kv : byNode) {
+            sort(kv.second.begin(), kv.second.end(), [](const CpuInfo& a, const CpuInfo& b) {
+                if (a.sibling != b.sibling) return a.sibling < b.sibling;
+                if (a.package != b.package) return a.package < b.package;
+                if (a.core != b.core) return a.core < b.core;
+                return a.cpu < b.cpu;
+            });
+            longest = max(longest, kv.second.size());
+        }
+        for (size_t i = 0; i < longest; i++) {
+            for (auto& kv : byNode) {
+                if (i < kv.second.size()) order_.push_back(kv.second[i].cpu);
+            }
+        }
+    } else {
+        vector<int> list;
+        if (!ParseList_(spec, &list) || list.empty()) {
+            return false;
+        }
+        policy_ = POLICY_LIST;
+        order_ = list;
+    }
+    return true;
+}
+
+const char* CpuPlacement::PolicyName() const {
+    switch (policy_) {
+    case POLICY_COMPACT: return "compact";
+    case POLICY_SPREAD: return "spread";
+    case POLICY_LIST: return "list";
+    default: return "none";
+    }
+}
+
+int CpuPlacement::CpuFor(int slot) const {
+    if (!Enabled() || slot < 0) {
+        return -1;
+    }
+    return order_[slot % order_.size()]; //线程多于CPU时循环使用
+}
+
+int CpuPlacement::NodeOf(int cpu) const {
+    const CpuInfo* c = Find_(cpu);
+    return c ? c->node : -1;
+}
+
+bool CpuPlacement::Pin(pthread_t thread, int cpu) {
+    if (cpu < 0) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+bool CpuPlacement::PinSelf(int cpu) {
+    if (!Pin(pthread_self(), cpu)) {
+        return false;
+    }
+    //绑定后线程已经迁移到目标CPU上；之后缺页分配的物理内存优先取自本节点（节点内存不足时退回其他节点）
+    threadNode_ = CurrentNode();
+    if (threadNode_ >= 0 && threadNode_ < static_cast<int>(sizeof(unsigned long) * 8)) {
+        unsigned long mask = 1UL << threadNode_;
+        syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8);
+    }
+    return true;
+}
+
+int CpuPlacement::CurrentNode() {
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+        return -1;
+    }
+    return static_cast<int>(node);
+}
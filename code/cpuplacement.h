@@ -0,0 +1,70 @@
+/*
+线程的CPU绑定策略（事件循环、工作线程、日志写线程）：
+- none：不绑定，由调度器决定；
+- compact：按 NUMA节点 -> 物理核 -> 超线程 的顺序紧凑排列，线程尽量共享同一节点的缓存；
+- spread：轮流分布到各个 NUMA节点，优先使用不同的物理核，超线程最后使用；
+- CPU列表：如 "0,2,4-7"，按给出的顺序使用。
+logCpu >= 0 时把日志写线程单独绑定到该CPU（管理核），其余线程不再使用它。
+拓扑信息读取 /sys/devices/system/cpu，只使用进程当前允许运行的CPU。
+线程绑定自己（PinSelf）后记下所在的NUMA节点，并把内存策略设为优先从该节点分配，
+Buffer的数据块和FileCache的内容按这个节点分池存放。
+*/
+
+#ifndef CPUPLACEMENT_H
+#define CPUPLACEMENT_H
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+class CpuPlacement {
+public:
+    enum POLICY {
+        POLICY_NONE = 0,
+        POLICY_COMPACT,
+        POLICY_SPREAD,
+        POLICY_LIST,
+    };
+
+    CpuPlacement();
+
+    //解析策略并计算分配顺序；策略无法识别或CPU列表为空时返回false（此时不绑定）
+    bool Init(const char* spec, int logCpu);
+
+    bool Enabled() const { return policy_ != POLICY_NONE && !order_.empty(); }
+    const char* PolicyName() const;
+    //第slot个线程（事件循环在前、工作线程在后依次编号）使用的CPU，不绑定时返回-1
+    int CpuFor(int slot) const;
+    int LogCpu() const { return logCpu_; }
+    int NodeOf(int cpu) const;
+    int NodeCount() const { return nodeCount_; }
+    int CpuCount() const { return static_cast<int>(cpus_.size()); }
+
+    static bool Pin(pthread_t thread, int cpu);
+    static bool PinSelf(int cpu); //绑定当前线程，成功后记录节点并优先从该节点分配内存
+    static int CurrentNode(); //当前线程所在的NUMA节点
+    static int ThreadNode() { return threadNode_; } //当前线程PinSelf绑定到的NUMA节点，没有绑定为-1
+
+private:
+    struct CpuInfo {
+        int cpu;
+        int node;
+        int package; //物理CPU（插槽）
+        int core; //物理核
+        int sibling; //同一物理核上的第几个超线程
+    };
+
+    void LoadTopology_();
+    bool ParseList_(const char* spec, std::vector<int>* cpus) const;
+    const CpuInfo* Find_(int cpu) const;
+
+    POLICY policy_;
+    int logCpu_;
+    int nodeCount_;
+    std::vector<CpuInfo> cpus_; //允许使用的CPU及拓扑
+    std::vector<int> order_; //线程依次使用的CPU
+
+    static thread_local int threadNode_;
+};
+
+#endif
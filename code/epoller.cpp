@@ -1,40 +1,204 @@
 #include "epoller.h"
+#include <string.h>
+#include <fcntl.h>
+#include <algorithm>
 
-Epoller::Epoller(int maxEvent) : epollFd_(epoll_create1(0)), events_(maxEvent) { 
-    // 改用 epoll_create1(0) 替代 epoll_create(512)（现代推荐用法）
-    assert(epollFd_ >= 0 && events_.size() > 0);
+//io_uring后端的user_data编码：高8位为请求类型，中间24位为fd的代数，低32位为fd
+enum URING_OP {
+    URING_POLL = 1, //poll请求（模拟epoll就绪通知）
+    URING_REMOVE = 2, //取消poll请求
+    URING_ACCEPT = 3, //multishot accept
+    URING_RECV = 4, //连接的multishot recv（提供缓冲区）
+    URING_SENDMSG = 5, //发送链：内存数据
+    URING_SPLICE_IN = 6, //发送链：文件 -> 管道
+    URING_SPLICE_OUT = 7, //发送链：管道 -> socket
+};
+
+static inline uint64_t UringData(int op, uint32_t gen, int fd) {
+    return (static_cast<uint64_t>(op) << 56) | (static_cast<uint64_t>(gen & 0xffffff) << 32)
+            | static_cast<uint32_t>(fd);
+}
+
+//poll只认识事件位，ET/ONESHOT等epoll控制位需要去掉
+static const uint32_t POLL_MASK = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLPRI | EPOLLERR | EPOLLHUP;
+
+Epoller::Epoller(int maxEvent, bool useIoUring) : epollFd_(-1), events_(maxEvent), ctlCount_(0), ringIo_(false) {
+    assert(events_.size() > 0);
+    if (useIoUring) {
+        uring_.reset(new IoUring(maxEvent));
+        if (!uring_->IsOpen() || !UringSupported_(*uring_)) {
+            uring_.reset(); //内核不支持所需特性，回退到epoll
+        }
+    }
+    //连接的收发：multishot recv与IORING_OP_SEND_ZC同在6.0加入，用它判断；缓冲区环注册失败时连接退回poll + 直接读写
+    if (uring_ && uring_->HasOp(IORING_OP_SEND_ZC) && uring_->HasOp(IORING_OP_SENDMSG)
+            && uring_->HasOp(IORING_OP_SPLICE) && uring_->HasOp(IORING_OP_ASYNC_CANCEL)) {
+        ringIo_ = uring_->SetupBufRing(RECV_BUFS, RECV_BUF_SIZE, RECV_GROUP);
+    }
+    if (!uring_) {
+        // 改用 epoll_create1(0) 替代 epoll_create(512)（现代推荐用法）
+        epollFd_ = epoll_create1(0);
+        assert(epollFd_ >= 0);
+    }
 }
 
 Epoller::~Epoller() {
-    close(epollFd_);
+    if (epollFd_ >= 0) close(epollFd_);
 }
 
 bool Epoller::AddFd(int fd, uint32_t events) {
     if (fd < 0) return false;
+    epoll_data_t data;
+    data.u64 = 0;
+    data.fd = fd; //填写“监控目标”：告诉epoll要监视的是哪个fd
+    if (uring_) return UringCtl_(EPOLL_CTL_ADD, fd, events, data, false);
+    return Ctl_(EPOLL_CTL_ADD, fd, events, data);
+}
+
+bool Epoller::ModFd(int fd, uint32_t events) {
+    if (fd < 0) return false;
+    epoll_data_t data;
+    data.u64 = 0;
+    data.fd = fd;
+    if (uring_) return UringCtl_(EPOLL_CTL_MOD, fd, events, data, false);
+    return Ctl_(EPOLL_CTL_MOD, fd, events, data);
+}
+
+bool Epoller::AddFd(int fd, uint32_t events, void* ptr) {
+    if (fd < 0) return false;
+    epoll_data_t data;
+    data.ptr = ptr;
+    if (uring_) return UringCtl_(EPOLL_CTL_ADD, fd, events, data, true);
+    return Ctl_(EPOLL_CTL_ADD, fd, events, data);
+}
+
+bool Epoller::ModFd(int fd, uint32_t events, void* ptr) {
+    if (fd < 0) return false;
+    epoll_data_t data;
+    data.ptr = ptr;
+    if (uring_) return UringCtl_(EPOLL_CTL_MOD, fd, events, data, true);
+    return Ctl_(EPOLL_CTL_MOD, fd, events, data);
+}
+
+bool Epoller::DelFd(int fd) {
+    if(fd < 0) return false;
+    epoll_data_t data;
+    data.u64 = 0;
+    if (uring_) return UringCtl_(EPOLL_CTL_DEL, fd, 0, data, false);
+    return Ctl_(EPOLL_CTL_DEL, fd, 0, data);
+}
+
+bool Epoller::AddListenFd(int fd, uint32_t events, void* ptr) {
+    if (fd < 0) return false;
+    epoll_data_t data;
+    data.ptr = ptr;
+    if (!uring_) {
+        return Ctl_(EPOLL_CTL_ADD, fd, events, data);
+    }
+    bool ok, defer;
+    {
+        std::lock_guard<std::mutex> locker(uringMtx_);
+        defer = UringDefer_();
+        UringFd& st = UringState_(fd);
+        st.gen++;
+        st.events = events;
+        st.ptr = ptr;
+        st.usePtr = true;
+        st.listen = true;
+        ok = UringArm_(fd, st);
+    }
+    return ok && (defer || UringFlush_());
+}
+
+bool Epoller::Ctl_(int op, int fd, uint32_t events, const epoll_data_t& data) {
     //创建并初始化epoll_event结构体
     epoll_event ev = {0};
-    ev.data.fd = fd; //填写“监控目标”：告诉epoll要监视的是哪个fd
+    ev.data = data;
     ev.events = events; //填写“关注的事件”：告诉epoll要监视这个fd的哪些状态
+    ctlCount_.fetch_add(1, std::memory_order_relaxed);
     //其中epollFd是epoll实例，用于监控
-    return 0 == epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+    return 0 == epoll_ctl(epollFd_, op, fd, op == EPOLL_CTL_DEL ? nullptr : &ev);
 }
 
-bool Epoller::ModFd(int fd, uint32_t events) {
+bool Epoller::AddConnFd(int fd, uint32_t events, void* ptr) {
+    if (!ringIo_) {
+        return AddFd(fd, events, ptr);
+    }
     if (fd < 0) return false;
-    epoll_event ev = {0};
-    ev.data.fd = fd;
-    ev.events = events;
-    return 0 == epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev); // 调用 EPOLL_CTL_MOD 修改事件
+    bool ok, defer;
+    {
+        std::lock_guard<std::mutex> locker(uringMtx_);
+        defer = UringDefer_();
+        UringFd& st = UringState_(fd);
+        UringDisarm_(fd, st);
+        UringResetConn_(st);
+        st.gen++;
+        st.events = events;
+        st.ptr = ptr;
+        st.usePtr = true;
+        st.listen = false;
+        st.conn = true;
+        ok = UringArm_(fd, st);
+    }
+    return ok && (defer || UringFlush_());
 }
 
-bool Epoller::DelFd(int fd) {
-    if(fd < 0) return false;
-    return 0 == epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, 0);
+bool Epoller::UringCtl_(int op, int fd, uint32_t events, const epoll_data_t& data, bool usePtr) {
+    bool ok = true, defer;
+    {
+        std::lock_guard<std::mutex> locker(uringMtx_);
+        defer = UringDefer_();
+        UringFd& st = UringState_(fd);
+        if (st.conn && op == EPOLL_CTL_MOD) {
+            //连接的recv一直挂着，只更新关注的事件；ONESHOT重新开启时已经就绪的事件在下一次Wait报告
+            assert(defer);
+            st.events = events;
+            st.ptr = data.ptr;
+            st.usePtr = usePtr;
+            st.disabled = false;
+            if (st.ready & events & (EPOLLIN | EPOLLOUT)) {
+                readyQue_.push_back(fd);
+            }
+            return true;
+        }
+        UringDisarm_(fd, st);
+        UringResetConn_(st); //发送链若还没结束，其结果随代数变化一并丢弃（调用方先用CloseLater等它结束）
+        st.gen++; //旧请求若已完成但尚未收割，其结果随代数变化一并丢弃
+        st.events = events;
+        st.ptr = data.ptr;
+        st.usePtr = usePtr;
+        st.listen = false;
+        if (op != EPOLL_CTL_DEL) {
+            ok = UringArm_(fd, st);
+        }
+    }
+    return ok && (defer || UringFlush_());
+}
+
+int Epoller::Accept(int listenFd, struct sockaddr* addr, socklen_t* len) {
+    if (!uring_) {
+        return accept(listenFd, addr, len);
+    }
+    std::lock_guard<std::mutex> locker(uringMtx_);
+    if (acceptQue_.empty()) {
+        errno = EAGAIN;
+        return -1;
+    }
+    int fd = acceptQue_.front();
+    acceptQue_.pop_front();
+    if (addr && len) {
+        memset(addr, 0, *len);
+        addr->sa_family = AF_UNSPEC;
+    }
+    return fd;
 }
 
 //等待并收集就绪事件，等待时间为timeoutMs
 //返回的是就绪事件的数量
 int Epoller::Wait(int timeoutMs) {
+    if (uring_) {
+        return UringWait_(timeoutMs);
+    }
     // 调用系统函数 epoll_wait，等待事件发生
     return epoll_wait(
         epollFd_,          // 1. 监控中心标识（哪个 epoll 实例）
@@ -46,12 +210,503 @@ int Epoller::Wait(int timeoutMs) {
 
 //获取事件fd
 int Epoller::GetEventFd(size_t i) const {
-    assert(i < events_.size()); 
+    assert(i < events_.size());
     return events_[i].data.fd;
 }
 
+//获取事件的用户指针（以带指针的方式注册的fd）
+void* Epoller::GetEventPtr(size_t i) const {
+    assert(i < events_.size());
+    return events_[i].data.ptr;
+}
+
 //获取事件属性
 uint32_t Epoller::GetEvents(size_t i) const {
-    assert(i < events_.size()); 
+    assert(i < events_.size());
     return events_[i].events;
-}
\ No newline at end of file
+}
+
+//io_uring后端需要：不丢完成事件、带超时的等待、poll/accept相关操作码
+//IORING_OP_SOCKET与multishot accept同在5.19加入，用它判断multishot是否可用
+bool Epoller::UringSupported_(const IoUring& ring) {
+    const unsigned need = IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    return (ring.Features() & need) == need
+        && ring.HasOp(IORING_OP_POLL_ADD) && ring.HasOp(IORING_OP_POLL_REMOVE)
+        && ring.HasOp(IORING_OP_ACCEPT) && ring.HasOp(IORING_OP_SOCKET);
+}
+
+Epoller::UringFd& Epoller::UringState_(int fd) {
+    if (static_cast<size_t>(fd) >= uringFds_.size()) {
+        uringFds_.resize(fd + 1);
+    }
+    return uringFds_[fd];
+}
+
+struct io_uring_sqe* Epoller::UringSqe_() {
+    struct io_uring_sqe* sqe = uring_->GetSqe();
+    while (!sqe) {
+        //SQ已满：先把已有的请求提交给内核再重试
+        uring_->Enter(0, 0);
+        sqe = uring_->GetSqe();
+    }
+    return sqe;
+}
+
+bool Epoller::UringArm_(int fd, UringFd& st) {
+    struct io_uring_sqe* sqe = UringSqe_();
+    sqe->fd = fd;
+    if (st.listen) {
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->user_data = UringData(URING_ACCEPT, st.gen, fd);
+    } else if (st.conn) {
+        //multishot recv：每收到一段数据内核从缓冲区环取一个缓冲区，产生一个完成事件
+        sqe->opcode = IORING_OP_RECV;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = RECV_GROUP;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->user_data = UringData(URING_RECV, st.gen, fd);
+    } else {
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->poll32_events = st.events & POLL_MASK;
+        //非ONESHOT的关注使用multishot poll，内核每次唤醒都会产生一个完成事件
+        if (!(st.events & EPOLLONESHOT)) {
+            sqe->len = IORING_POLL_ADD_MULTI;
+        }
+        sqe->user_data = UringData(URING_POLL, st.gen, fd);
+    }
+    uring_->Publish();
+    ctlCount_.fetch_add(1, std::memory_order_relaxed);
+    st.armed = true;
+    return true;
+}
+
+bool Epoller::UringDisarm_(int fd, UringFd& st) {
+    if (!st.armed) return false;
+    if (st.listen || st.conn) {
+        UringCancel_(fd, st.gen, st.listen ? URING_ACCEPT : URING_RECV);
+    } else {
+        struct io_uring_sqe* sqe = UringSqe_();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->addr = UringData(URING_POLL, st.gen, fd);
+        sqe->fd = -1;
+        sqe->user_data = UringData(URING_REMOVE, st.gen, fd);
+        uring_->Publish();
+        ctlCount_.fetch_add(1, std::memory_order_relaxed);
+    }
+    st.armed = false;
+    return true;
+}
+
+//取消multishot accept/recv，被取消的请求以-ECANCELED结束
+void Epoller::UringCancel_(int fd, uint32_t gen, int op) {
+    struct io_uring_sqe* sqe = UringSqe_();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = UringData(op, gen, fd);
+    sqe->fd = -1;
+    sqe->user_data = UringData(URING_REMOVE, gen, fd);
+    uring_->Publish();
+    ctlCount_.fetch_add(1, std::memory_order_relaxed);
+}
+
+//事件循环线程的修改留到下一次Wait时与等待一起提交，其它线程需要立即提交（需持有uringMtx_）
+void Epoller::UringFill_(size_t i, int fd, const UringFd& st, uint32_t events) {
+    if (st.usePtr) {
+        events_[i].data.ptr = st.ptr;
+    } else {
+        events_[i].data.fd = fd;
+    }
+    events_[i].events = events;
+}
+
+bool Epoller::UringDefer_() const {
+    return std::this_thread::get_id() == loopThread_;
+}
+
+bool Epoller::UringFlush_() {
+    return uring_->Enter(0, 0) >= 0;
+}
+
+int Epoller::UringWait_(int timeoutMs) {
+    unsigned minComplete;
+    {
+        std::lock_guard<std::mutex> locker(uringMtx_);
+        loopThread_ = std::this_thread::get_id();
+        //完成队列中已有事件、或有待报告的连接时不再阻塞，只提交
+        minComplete = (uring_->PeekCqe() || !readyQue_.empty()) ? 0 : 1;
+    }
+    if (uring_->Enter(minComplete, timeoutMs) < 0 && errno != EBUSY) {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> locker(uringMtx_);
+    size_t n = 0;
+    if (!readyQue_.empty()) {
+        std::vector<int> que;
+        que.swap(readyQue_);
+        for (int fd : que) {
+            UringFd& st = uringFds_[fd];
+            if (st.conn) {
+                UringReport_(fd, st, st.ready, n); //事件数组满了会重新排进readyQue_
+            }
+        }
+    }
+    struct io_uring_cqe* cqe;
+    while (n < events_.size() && (cqe = uring_->PeekCqe()) != nullptr) {
+        int op = static_cast<int>(cqe->user_data >> 56);
+        uint32_t gen = static_cast<uint32_t>(cqe->user_data >> 32) & 0xffffff;
+        int fd = static_cast<int>(cqe->user_data & 0xffffffff);
+        int res = cqe->res;
+        uint32_t flags = cqe->flags;
+        bool more = flags & IORING_CQE_F_MORE;
+        uring_->SeenCqe();
+
+        if (op == URING_RECV) {
+            UringRecv_(fd, gen, res, flags, n); //带缓冲区的结果即使过期也要归还缓冲区
+            continue;
+        }
+        if (op == URING_SENDMSG || op == URING_SPLICE_IN || op == URING_SPLICE_OUT) {
+            UringSent_(op, fd, gen, res, n);
+            continue;
+        }
+        if (op == URING_REMOVE || static_cast<size_t>(fd) >= uringFds_.size()) {
+            continue;
+        }
+        UringFd& st = uringFds_[fd];
+        bool current = ((st.gen & 0xffffff) == gen);
+        if (op == URING_ACCEPT) {
+            if (!current) {
+                if (res >= 0) close(res); //监听socket已注销，丢弃迟到的连接
+                continue;
+            }
+            if (res >= 0) {
+                acceptQue_.push_back(res);
+                UringFill_(n, fd, st, EPOLLIN);
+                n++;
+            }
+            if (!more) {
+                //multishot accept被内核终止（如fd耗尽），重新挂上
+                st.armed = false;
+                UringArm_(fd, st);
+            }
+            continue;
+        }
+        if (!current) {
+            continue; //过期的poll结果（fd已被修改或删除）
+        }
+        if (!more) {
+            st.armed = false;
+        }
+        if (res < 0) {
+            continue;
+        }
+        UringFill_(n, fd, st, static_cast<uint32_t>(res));
+        n++;
+        if (!st.armed && !(st.events & EPOLLONESHOT)) {
+            UringArm_(fd, st); //持续关注的fd，multishot poll终止后重新挂上
+        }
+    }
+    return static_cast<int>(n);
+}
+
+//连接的recv结果：数据按到达顺序排在连接上，由Recv取走后归还缓冲区
+void Epoller::UringRecv_(int fd, uint32_t gen, int res, uint32_t flags, size_t& n) {
+    bool hasBuf = flags & IORING_CQE_F_BUFFER;
+    unsigned short bid = static_cast<unsigned short>(flags >> IORING_CQE_BUFFER_SHIFT);
+    UringFd* st = static_cast<size_t>(fd) < uringFds_.size() ? &uringFds_[fd] : nullptr;
+    if (!st || !st->conn || (st->gen & 0xffffff) != gen) {
+        if (hasBuf) {
+            uring_->RecycleBuf(bid); //连接已注销
+            UringRearmStarved_();
+        }
+        return;
+    }
+    bool more = flags & IORING_CQE_F_MORE;
+    bool report = true;
+    if (res > 0 && hasBuf) {
+        st->recvd.push_back({bid, 0, static_cast<uint32_t>(res)});
+        if (more && !st->recvPaused && st->recvd.size() >= RECV_CONN_BUFS) {
+            //对端只发不收时数据会一直堆在这个连接上：暂停接收，交给socket缓冲区反压
+            UringCancel_(fd, st->gen, URING_RECV);
+            st->recvPaused = true;
+        }
+        if (st->recvPaused) {
+            UringSpill_(*st); //积压的数据搬出缓冲区环，不占住其他连接要用的缓冲区
+        }
+    } else if (res == -ENOBUFS || (res == -ECANCELED && st->recvPaused)) {
+        report = false;
+    } else if (res == 0) {
+        st->recvEof = true;
+    } else {
+        if (hasBuf) uring_->RecycleBuf(bid);
+        st->recvErr = res < 0 ? -res : EIO;
+    }
+    if (!more) {
+        st->armed = false;
+        if (st->recvPaused) {
+            UringResume_(fd, *st); //积压在multishot结束之前已经取走
+        } else if (res == -ENOBUFS) {
+            starved_.push_back(fd); //缓冲区用尽：等有缓冲区归还后再挂上
+        } else if (res > 0) {
+            UringArm_(fd, *st); //内核结束了multishot（如CQ溢出），重新挂上
+        }
+    }
+    if (report) {
+        st->ready |= EPOLLIN;
+        UringReport_(fd, *st, EPOLLIN, n);
+    }
+}
+
+//发送链中一步的结果：全部结束后报告EPOLLOUT（或交给TakeClosable关闭）
+void Epoller::UringSent_(int op, int fd, uint32_t gen, int res, size_t& n) {
+    if (static_cast<size_t>(fd) >= uringFds_.size()) {
+        return;
+    }
+    UringFd& st = uringFds_[fd];
+    if (!st.conn || (st.gen & 0xffffff) != gen || st.sendLeft == 0) {
+        return; //连接已注销
+    }
+    SendResult& result = st.sendRes;
+    if (res > 0) {
+        (op == URING_SPLICE_IN ? result.piped : result.sent) += res;
+    } else if (res != -ECANCELED && result.err == 0) {
+        result.err = res < 0 ? -res : EIO; //splice返回0：文件被截短
+    }
+    if (--st.sendLeft > 0) {
+        return;
+    }
+    if (st.closeLater) {
+        closable_.push_back(fd);
+        return;
+    }
+    st.ready |= EPOLLOUT;
+    UringReport_(fd, st, EPOLLOUT, n);
+}
+
+//events中关注且未被ONESHOT关闭的事件填进事件数组；数组已满时留到下一次Wait
+bool Epoller::UringReport_(int fd, UringFd& st, uint32_t events, size_t& n) {
+    uint32_t ev = events & st.events & (EPOLLIN | EPOLLOUT);
+    if (!ev || st.disabled) {
+        return false;
+    }
+    if (n >= events_.size()) {
+        readyQue_.push_back(fd);
+        return false;
+    }
+    UringFill_(n++, fd, st, ev);
+    if (st.events & EPOLLONESHOT) {
+        st.disabled = true;
+    }
+    return true;
+}
+
+void Epoller::UringResetConn_(UringFd& st) {
+    bool recycled = !st.recvd.empty();
+    for (const RecvChunk& chunk : st.recvd) {
+        uring_->RecycleBuf(chunk.bid);
+    }
+    st.recvd.clear();
+    std::string().swap(st.spill);
+    st.spillOff = 0;
+    st.conn = false;
+    st.recvPaused = false;
+    st.recvEof = false;
+    st.recvErr = 0;
+    st.ready = 0;
+    st.disabled = false;
+    st.sendLeft = 0;
+    st.sendRes = SendResult();
+    st.closeLater = false;
+    if (recycled) {
+        UringRearmStarved_();
+    }
+}
+
+//暂停接收的连接：旧的multishot已经结束、积压全部取走后重新挂上
+bool Epoller::UringResume_(int fd, UringFd& st) {
+    if (st.armed || !st.spill.empty() || !st.recvd.empty()) {
+        return false;
+    }
+    st.recvPaused = false;
+    return !st.recvEof && st.recvErr == 0 && UringArm_(fd, st);
+}
+
+void Epoller::UringSpill_(UringFd& st) {
+    for (const RecvChunk& chunk : st.recvd) {
+        st.spill.append(uring_->Buf(chunk.bid) + chunk.off, chunk.len - chunk.off);
+        uring_->RecycleBuf(chunk.bid);
+    }
+    st.recvd.clear();
+    UringRearmStarved_();
+}
+
+bool Epoller::UringRearmStarved_() {
+    bool armed = false;
+    for (int fd : starved_) {
+        UringFd& st = uringFds_[fd];
+        if (st.conn && !st.armed && !st.recvEof && st.recvErr == 0) {
+            armed = UringArm_(fd, st) || armed;
+        }
+    }
+    starved_.clear();
+    return armed;
+}
+
+ssize_t Epoller::Recv(int fd, char* buf, size_t len, int* err) {
+    assert(ringIo_);
+    ssize_t got = 0;
+    bool flush = false, defer;
+    {
+        std::lock_guard<std::mutex> locker(uringMtx_);
+        defer = UringDefer_();
+        UringFd& st = UringState_(fd);
+        bool recycled = false;
+        if (st.spillOff < st.spill.size()) {
+            got = std::min(len, st.spill.size() - st.spillOff);
+            memcpy(buf, st.spill.data() + st.spillOff, got);
+            st.spillOff += got;
+            if (st.spillOff == st.spill.size()) {
+                std::string().swap(st.spill);
+                st.spillOff = 0;
+            }
+        }
+        while (!st.recvd.empty() && static_cast<size_t>(got) < len) {
+            RecvChunk& chunk = st.recvd.front();
+            size_t k = std::min(len - got, static_cast<size_t>(chunk.len - chunk.off));
+            memcpy(buf + got, uring_->Buf(chunk.bid) + chunk.off, k);
+            got += k;
+            chunk.off += k;
+            if (chunk.off == chunk.len) {
+                uring_->RecycleBuf(chunk.bid);
+                st.recvd.pop_front();
+                recycled = true;
+            }
+        }
+        if (recycled && !starved_.empty()) {
+            flush = UringRearmStarved_();
+        }
+        if (st.recvPaused) {
+            flush = UringResume_(fd, st) || flush;
+        }
+        if (st.recvd.empty() && st.spill.empty() && !st.recvEof && st.recvErr == 0) {
+            st.ready &= ~EPOLLIN;
+        }
+        if (got == 0) {
+            if (st.recvErr) {
+                *err = st.recvErr;
+                got = -1;
+            } else if (!st.recvEof) {
+                *err = EAGAIN;
+                got = -1;
+            }
+        }
+    }
+    if (flush && !defer) {
+        UringFlush_();
+    }
+    return got;
+}
+
+bool Epoller::Send(int fd, const SendChain& chain) {
+    assert(ringIo_);
+    unsigned count = (chain.msg ? 1 : 0) + (chain.drain > 0 ? 1 : 0)
+                   + 2 * static_cast<unsigned>((chain.fileLen + PIPE_CHUNK - 1) / PIPE_CHUNK);
+    bool defer;
+    {
+        std::lock_guard<std::mutex> locker(uringMtx_);
+        defer = UringDefer_();
+        UringFd& st = UringState_(fd);
+        if (!st.conn || st.sendLeft > 0 || count == 0) {
+            return false;
+        }
+        if (uring_->SqSpace() < count) {
+            uring_->Enter(0, 0); //一条链必须在同一次提交中，否则会在提交边界断开
+            if (uring_->SqSpace() < count) {
+                return false;
+            }
+        }
+        //除最后一步外都带IOSQE_IO_LINK：前一步成功且完整后才执行下一步
+        struct io_uring_sqe* prev = nullptr;
+        auto next = [&](int op) {
+            if (prev) prev->flags |= IOSQE_IO_LINK;
+            prev = uring_->GetSqe();
+            prev->user_data = UringData(op, st.gen, fd);
+            return prev;
+        };
+        bool more = chain.drain > 0 || chain.fileLen > 0;
+        if (chain.msg) {
+            struct io_uring_sqe* sqe = next(URING_SENDMSG);
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = fd;
+            sqe->addr = reinterpret_cast<unsigned long long>(chain.msg);
+            sqe->len = 1;
+            //MSG_WAITALL：内核发送缓冲区满时等待可写后接着发，只有全部发完或出错才完成（不足会断开链接）
+            sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL | (more ? MSG_MORE : 0);
+        }
+        auto splice = [&](int op, int in, int64_t inOff, int out, size_t len, bool last) {
+            struct io_uring_sqe* sqe = next(op);
+            sqe->opcode = IORING_OP_SPLICE;
+            sqe->fd = out;
+            sqe->off = static_cast<uint64_t>(-1);
+            sqe->splice_fd_in = in;
+            sqe->splice_off_in = static_cast<uint64_t>(inOff);
+            sqe->len = static_cast<unsigned>(len);
+            sqe->splice_flags = SPLICE_F_MOVE | (last ? 0 : SPLICE_F_MORE);
+        };
+        if (chain.drain > 0) {
+            splice(URING_SPLICE_OUT, chain.pipeRd, -1, fd, chain.drain, chain.fileLen == 0);
+        }
+        //文件按管道容量分段：文件 -> 管道 -> socket（splice在io-wq线程中执行，socket需为阻塞模式）
+        const size_t chunk = PIPE_CHUNK;
+        for (size_t done = 0; done < chain.fileLen; ) {
+            size_t len = std::min(chunk, chain.fileLen - done);
+            splice(URING_SPLICE_IN, chain.fileFd, chain.offset + done, chain.pipeWr, len, false);
+            done += len;
+            splice(URING_SPLICE_OUT, chain.pipeRd, -1, fd, len, done == chain.fileLen);
+        }
+        uring_->Publish();
+        st.sendLeft = count;
+        st.sendRes = SendResult();
+        st.ready &= ~EPOLLOUT;
+    }
+    return defer || UringFlush_();
+}
+
+bool Epoller::TakeSent(int fd, SendResult* res) {
+    std::lock_guard<std::mutex> locker(uringMtx_);
+    UringFd& st = UringState_(fd);
+    if (st.sendLeft > 0) {
+        return false;
+    }
+    *res = st.sendRes;
+    st.sendRes = SendResult();
+    st.ready &= ~EPOLLOUT;
+    return true;
+}
+
+bool Epoller::CloseLater(int fd) {
+    if (!ringIo_) {
+        return false;
+    }
+    std::lock_guard<std::mutex> locker(uringMtx_);
+    UringFd& st = UringState_(fd);
+    if (!st.conn || st.sendLeft == 0) {
+        return false;
+    }
+    st.closeLater = true;
+    st.events = 0; //关闭之前不再报告事件（shutdown之后recv会报告EOF）
+    return true;
+}
+
+int Epoller::TakeClosable() {
+    if (!ringIo_) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> locker(uringMtx_);
+    if (closable_.empty()) {
+        return -1;
+    }
+    int fd = closable_.back();
+    closable_.pop_back();
+    return fd;
+}
@@ -2,27 +2,153 @@
 #define EPOLLER_H
 
 #include <sys/epoll.h>
+#include <sys/socket.h>
 #include <unistd.h> //包含close()函数（用于关闭epoll实例）
 #include <assert.h>
 #include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include <errno.h>
 
+#include "iouring.h"
+
+//IO多路复用器：默认使用epoll，也可以在启动时选择io_uring后端
+//两种后端对外接口一致：AddFd/ModFd/DelFd/Wait/GetEventFd/GetEvents
+//io_uring后端：监听socket使用multishot accept；客户端连接（AddConnFd）在内核支持提供缓冲区环时
+//由multishot recv把数据收进缓冲区环，连接用Recv取数据、Send提交链接的sendmsg/splice，
+//收到数据、发送链完成都以EPOLLIN/EPOLLOUT事件报告，连接不再直接读写socket，也不需要poll；
+//其余fd（eventfd等）用单次/多次poll模拟epoll的就绪通知。
+//注册修改和事件循环线程上提交的发送变成SQE，由事件循环在等待时一并提交（一次io_uring_enter完成提交+等待）
 class Epoller {
 public:
-    explicit Epoller(int maxEvent = 1024);
+    explicit Epoller(int maxEvent = 1024, bool useIoUring = false);
     ~Epoller();
 
     bool AddFd(int fd, uint32_t events);
     bool ModFd(int fd, uint32_t events);
+    //带用户指针的注册：事件就绪时通过GetEventPtr取回（epoll_event.data.ptr），省去fd到对象的查找
+    bool AddFd(int fd, uint32_t events, void* ptr);
+    bool ModFd(int fd, uint32_t events, void* ptr);
     bool DelFd(int fd);
     int Wait(int timeoutMs = -1);
-    
+
+    //监听socket专用：io_uring后端使用multishot accept，epoll后端等同于AddFd
+    bool AddListenFd(int fd, uint32_t events, void* ptr);
+    //接收新连接：epoll后端直接调用accept，io_uring后端从已完成的accept结果中取出
+    //io_uring后端拿不到对端地址，addr的sin_family置为AF_UNSPEC，由调用方按需getpeername
+    int Accept(int listenFd, struct sockaddr* addr, socklen_t* len);
+
+    //客户端连接专用：RingIo时数据由内核收进缓冲区环，连接通过Recv/Send收发；否则等同于AddFd
+    //这样注册的fd只能在事件循环线程上ModFd（重新开启ONESHOT时已就绪的事件在下一次Wait报告）
+    bool AddConnFd(int fd, uint32_t events, void* ptr);
+    bool RingIo() const { return ringIo_; } //连接的收发是否经过io_uring（提供缓冲区recv + 链接的发送）
+
+    //发送链：先把msg中的内存数据全部发完（MSG_WAITALL），再把管道中上次剩下的drain字节、
+    //然后把文件[offset, offset+fileLen)按管道容量分段经管道splice到socket（相当于sendfile），
+    //各步以IOSQE_IO_LINK依次执行，前一步失败或不足时后面的步骤取消
+    struct SendChain {
+        const struct msghdr* msg = nullptr; //没有内存数据时为nullptr；发送链完成之前必须保持有效
+        int fileFd = -1;
+        off_t offset = 0;
+        size_t fileLen = 0;
+        int pipeRd = -1; //splice用的管道
+        int pipeWr = -1;
+        size_t drain = 0;
+    };
+    struct SendResult {
+        size_t sent = 0; //送到socket的字节数
+        size_t piped = 0; //从文件读进管道的字节数（没有送出的留在管道中，下次drain）
+        int err = 0; //第一个失败步骤的错误码
+    };
+    //取出连接已收到的数据，最多len字节；没有数据时返回-1并置*err为EAGAIN，对端已关闭返回0，出错返回-1
+    ssize_t Recv(int fd, char* buf, size_t len, int* err);
+    //提交发送链（同一连接同一时刻只有一条），完成时报告一次EPOLLOUT事件，结果由TakeSent取回
+    bool Send(int fd, const SendChain& chain);
+    bool TakeSent(int fd, SendResult* res); //发送链还没有完成时返回false
+    //关闭连接之前调用：发送链还没有完成时返回true，此时fd和发送的内存还在被内核使用，
+    //不能关闭/释放，等发送链结束后由TakeClosable取出fd再关闭；返回false表示可以立即关闭
+    bool CloseLater(int fd);
+    int TakeClosable(); //没有时返回-1
+
     int GetEventFd(size_t i) const;
+    void* GetEventPtr(size_t i) const;
     uint32_t GetEvents(size_t i) const;
 
+    bool IsIoUring() const { return uring_ != nullptr; }
+    //累计的注册修改次数（epoll_ctl调用次数，io_uring后端为poll/accept的挂载与取消次数）
+    uint64_t CtlCount() const { return ctlCount_.load(std::memory_order_relaxed); }
+
 private:
+    //已收到、尚未被Recv取走的数据：缓冲区环中编号为bid的缓冲区的[off, len)
+    struct RecvChunk {
+        unsigned short bid;
+        uint32_t off;
+        uint32_t len;
+    };
+    //io_uring后端：每个fd的注册状态
+    struct UringFd {
+        uint32_t gen = 0; //代数，fd被删除/重新注册时递增，用于丢弃过期的完成事件
+        uint32_t events = 0; //关注的事件
+        void* ptr = nullptr; //注册时的用户指针（usePtr为false时事件中返回fd）
+        bool usePtr = false;
+        bool armed = false; //是否有尚未完成的poll请求
+        bool listen = false; //是否为multishot accept的监听socket
+        //以下只用于AddConnFd注册的连接（RingIo）
+        bool conn = false; //armed表示有尚未结束的multishot recv
+        bool recvPaused = false; //积压过多，已取消recv，积压取走后再挂上
+        bool recvEof = false; //对端已关闭
+        int recvErr = 0; //recv失败的错误码
+        std::deque<RecvChunk> recvd;
+        std::string spill; //暂停接收时从缓冲区环搬出的数据，先于recvd取走
+        size_t spillOff = 0;
+        uint32_t ready = 0; //已就绪的事件：EPOLLIN为有数据/已关闭/出错，EPOLLOUT为发送链已完成未取走
+        bool disabled = false; //ONESHOT的事件已报告，ModFd之前不再报告
+        int sendLeft = 0; //发送链中尚未完成的SQE数
+        SendResult sendRes;
+        bool closeLater = false; //发送链结束后关闭
+    };
+    static const unsigned RECV_BUFS = 256; //缓冲区环中的缓冲区数
+    static const unsigned RECV_BUF_SIZE = 16 * 1024;
+    static const unsigned short RECV_GROUP = 0;
+    static const size_t RECV_CONN_BUFS = 16; //单个连接最多积压的缓冲区数（与ET模式一次读的上限相当）
+    static const size_t PIPE_CHUNK = 64 * 1024; //一次splice的字节数（管道的默认容量）
+    static bool UringSupported_(const IoUring& ring);
+    UringFd& UringState_(int fd);
+    bool Ctl_(int op, int fd, uint32_t events, const epoll_data_t& data);
+    bool UringCtl_(int op, int fd, uint32_t events, const epoll_data_t& data, bool usePtr);
+    bool UringArm_(int fd, UringFd& st);
+    bool UringDisarm_(int fd, UringFd& st);
+    void UringCancel_(int fd, uint32_t gen, int op);
+    bool UringResume_(int fd, UringFd& st);
+    void UringSpill_(UringFd& st);
+    void UringResetConn_(UringFd& st); //归还连接尚未取走的数据占用的缓冲区，清空连接状态
+    bool UringRearmStarved_(); //缓冲区归还后重新挂上因缓冲区用尽而停止的recv，有新SQE时返回true
+    bool UringReport_(int fd, UringFd& st, uint32_t events, size_t& n); //报告连接已就绪的事件
+    void UringRecv_(int fd, uint32_t gen, int res, uint32_t flags, size_t& n);
+    void UringSent_(int op, int fd, uint32_t gen, int res, size_t& n);
+    bool UringDefer_() const; //当前线程是否为事件循环线程（其修改可延迟提交）
+    bool UringFlush_(); //非事件循环线程修改注册后需要立即提交
+    struct io_uring_sqe* UringSqe_();
+    void UringFill_(size_t i, int fd, const UringFd& st, uint32_t events);
+    int UringWait_(int timeoutMs);
+
     int epollFd_;
     std::vector<struct epoll_event> events_;
+    std::atomic<uint64_t> ctlCount_;
+
+    std::unique_ptr<IoUring> uring_;
+    std::mutex uringMtx_; //SQ环只能单生产者写入，工作线程也会ModFd/DelFd
+    std::vector<UringFd> uringFds_;
+    std::deque<int> acceptQue_; //multishot accept得到但尚未被取走的连接
+    bool ringIo_;
+    std::vector<int> starved_; //缓冲区用尽而停止接收的连接
+    std::vector<int> readyQue_; //ModFd重新开启后、或事件数组已满时待报告的连接
+    std::vector<int> closable_; //发送链已结束、可以关闭的连接
+    std::thread::id loopThread_; //调用Wait的事件循环线程，其修改可延迟到下次Wait批量提交
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,509 @@
+#include "filecache.h"
+#include "cpuplacement.h"
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <zlib.h>
+
+using namespace std;
+
+//文件后缀名与MIME类型的映射
+static const unordered_map<string, string> SUFFIX_TYPE = {
+    { ".html",  "text/html" },
+    { ".xml",   "text/xml" },
+    { ".xhtml", "application/xhtml+xml" },
+    { ".txt",   "text/plain" },
+    { ".rtf",   "application/rtf" },
+    { ".pdf",   "application/pdf" },
+    { ".word",  "application/nsword" },
+    { ".png",   "image/png" },
+    { ".gif",   "image/gif" },
+    { ".jpg",   "image/jpeg" },
+    { ".jpeg",  "image/jpeg" },
+    { ".au",    "audio/basic" },
+    { ".mpeg",  "video/mpeg" },
+    { ".mpg",   "video/mpeg" },
+    { ".avi",   "video/x-msvideo" },
+    { ".gz",    "application/x-gzip" },
+    { ".tar",   "application/x-tar" },
+    { ".css",   "text/css"},
+    { ".js",    "text/javascript"},
+};
+
+//预先压缩好的文件的后缀和对应的Content-Encoding，按FileEntry::ENCODING排列
+static const char* SIBLING_SUFFIX[FileEntry::ENC_COUNT] = { ".br", ".gz" };
+static const char* ENCODING_NAME[FileEntry::ENC_COUNT] = { "br", "gzip" };
+
+static int64_t NowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts); //vDSO，不陷入内核
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+FileEntry::~FileEntry() {
+    if (mapped) {
+        munmap(data, st.st_size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+FileCache* FileCache::Instance() {
+    static FileCache cache;
+    return &cache;
+}
+
+FileCache::FileCache() : shards_(new Shard[SHARDS]), nodes_(1), gzipBytes_(0), budget_(64 << 20),
+                         shardBudget_((64 << 20) / SHARDS), sendfileMin_(16 * 1024), revalidateMs_(REVALIDATE_MS) {}
+
+void FileCache::Init(int budgetMB, long sendfileMin) {
+    Clear();
+    ClearGzip_();
+    budget_ = budgetMB > 0 ? static_cast<size_t>(budgetMB) << 20 : 0;
+    shardBudget_ = budget_ / (SHARDS * nodes_);
+    sendfileMin_ = sendfileMin;
+}
+
+void FileCache::SetNumaNodes(int nodes) {
+    Clear();
+    nodes_ = nodes > 1 ? nodes : 1;
+    shards_.reset(new Shard[SHARDS * nodes_]);
+    shardBudget_ = budget_ / (SHARDS * nodes_);
+}
+
+FileCache::Shard* FileCache::LocalShard_(const string& path) {
+    int node = nodes_ > 1 ? CpuPlacement::ThreadNode() : 0;
+    if (node < 0 || node >= nodes_) {
+        return nullptr;
+    }
+    return &ShardOf_(path, node);
+}
+
+string FileCache::MimeType(const string& path) {
+    //查找最后一个点，用于查找后缀
+    string::size_type idx = path.find_last_of('.');
+    if (idx == string::npos) {
+        return "text/plain"; //没找到，默认按纯文本处理
+    }
+    auto it = SUFFIX_TYPE.find(path.substr(idx));
+    if (it != SUFFIX_TYPE.end()) {
+        return it->second;
+    }
+    return "text/plain"; //从后缀表中无对应类型则按纯文本处理
+}
+
+const char* FileCache::EncodingName(int enc) {
+    return ENCODING_NAME[enc];
+}
+
+bool FileCache::SameFile_(const struct stat& a, const struct stat& b) {
+    return a.st_ino == b.st_ino && a.st_dev == b.st_dev
+        && a.st_size == b.st_size && a.st_mtim.tv_sec == b.st_mtim.tv_sec
+        && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec && a.st_mode == b.st_mode;
+}
+
+bool FileCache::SiblingsUnchanged_(const FileEntry& entry) {
+    if (!S_ISREG(entry.st.st_mode) || entry.st.st_size == 0) {
+        return true;
+    }
+    for (int i = 0; i < FileEntry::ENC_COUNT; i++) {
+        struct stat st;
+        bool exists = stat((entry.path + SIBLING_SUFFIX[i]).c_str(), &st) == 0;
+        if (exists != (entry.siblingSt[i].st_ino != 0) || (exists && !SameFile_(entry.siblingSt[i], st))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+FileCache::EntryPtr FileCache::Get(const string& path) {
+    Shard* local = LocalShard_(path);
+    if (!local) {
+        return Load_(path); //分节点时后台线程不属于任何节点，取到的项只给本次使用
+    }
+    Shard& shard = *local;
+    int64_t now = NowMs();
+    int64_t revalidate = revalidateMs_.load(memory_order_relaxed);
+    EntryPtr stale;
+    {
+        lock_guard<mutex> locker(shard.mtx);
+        auto it = shard.index.find(path);
+        if (it != shard.index.end()) {
+            EntryPtr entry = *it->second;
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second); //移到表头
+            if (now - entry->checkedAt.load(memory_order_relaxed) < revalidate) {
+                return entry; //命中：不做系统调用
+            }
+            stale = entry;
+        }
+    }
+    //过了确认间隔：stat一次，文件没变化就继续使用
+    if (stale) {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && SameFile_(stale->st, st) && SiblingsUnchanged_(*stale)) {
+            stale->checkedAt.store(now, memory_order_relaxed);
+            return stale;
+        }
+    }
+    EntryPtr entry = Load_(path);
+    lock_guard<mutex> locker(shard.mtx);
+    auto it = shard.index.find(path);
+    if (it != shard.index.end()) {
+        if (*it->second != stale) {
+            return *it->second; //其他线程已经加载过
+        }
+        Erase_(shard, it->second); //换掉过期的项；正在发送它的连接仍持有旧的映射
+    }
+    if (entry) {
+        Insert_(shard, entry);
+    }
+    return entry;
+}
+
+void FileCache::MakeHeaders_(FileEntry& entry) const {
+    //强ETag：同一路径上文件被替换（inode变）、改写（大小/修改时间变）后都会变化
+    char buf[96];
+    snprintf(buf, sizeof(buf), "\"%lx-%lx-%lx%09lx\"", static_cast<unsigned long>(entry.st.st_ino),
+             static_cast<unsigned long>(entry.st.st_size), static_cast<unsigned long>(entry.st.st_mtim.tv_sec),
+             static_cast<unsigned long>(entry.st.st_mtim.tv_nsec));
+    entry.etag = buf;
+    if (!entry.encoding.empty()) {
+        entry.etag.insert(entry.etag.size() - 1, "-" + entry.encoding); //各编码版本的ETag互不相同
+    }
+    struct tm tmGmt;
+    gmtime_r(&entry.st.st_mtime, &tmGmt);
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tmGmt);
+    entry.lastModified = buf;
+
+    entry.validators = "ETag: " + entry.etag + "\r\nLast-Modified: " + entry.lastModified + "\r\n";
+    auto age = maxAge_.find(entry.mime);
+    if (age == maxAge_.end()) {
+        age = maxAge_.find("*");
+    }
+    if (age != maxAge_.end()) {
+        entry.validators += "Cache-Control: max-age=" + to_string(age->second) + "\r\n";
+    }
+    bool hasVariant = false;
+    for (const auto& variant : entry.variants) {
+        hasVariant = hasVariant || variant;
+    }
+    if (hasVariant || !entry.encoding.empty()) {
+        entry.validators += "Vary: Accept-Encoding\r\n"; //同一URL按Accept-Encoding返回不同内容，代理缓存需要区分
+    }
+    entry.headers = "Content-type: " + entry.mime + "\r\n";
+    if (!entry.encoding.empty()) {
+        entry.headers += "Content-Encoding: " + entry.encoding + "\r\n";
+    }
+    entry.headers += "Content-length: " + to_string(entry.st.st_size) + "\r\nAccept-Ranges: bytes\r\n" + entry.validators;
+}
+
+bool FileCache::SetMaxAge(const string& spec) {
+    unordered_map<string, int> ages;
+    size_t pos = 0;
+    while (pos < spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == string::npos) end = spec.size();
+        string item = spec.substr(pos, end - pos);
+        pos = end + 1;
+        if (item.empty()) continue;
+        size_t eq = item.find('=');
+        if (eq == string::npos || eq == 0 || eq + 1 == item.size()) {
+            return false;
+        }
+        char* numEnd = nullptr;
+        long age = strtol(item.c_str() + eq + 1, &numEnd, 10);
+        if (*numEnd != '\0' || age < 0 || age > INT32_MAX) {
+            return false;
+        }
+        ages[item.substr(0, eq)] = static_cast<int>(age);
+    }
+    maxAge_.swap(ages);
+    Clear(); //已缓存的响应头按新设置重新生成
+    ClearGzip_();
+    return true;
+}
+
+FileCache::EntryPtr FileCache::Load_(const string& path) const {
+    shared_ptr<FileEntry> entry = make_shared<FileEntry>();
+    if (!Open_(path, *entry)) {
+        return nullptr;
+    }
+    entry->mime = MimeType(path);
+    if (S_ISREG(entry->st.st_mode) && entry->st.st_size > 0) {
+        LoadVariants_(*entry);
+    }
+    MakeHeaders_(*entry);
+    return entry;
+}
+
+bool FileCache::Open_(const string& path, FileEntry& entry) const {
+    //O_CLOEXEC：缓存的文件描述符会长期保持打开
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &entry.st) < 0) {
+        close(fd);
+        return false;
+    }
+    entry.path = path;
+    entry.checkedAt.store(NowMs(), memory_order_relaxed);
+    if (!S_ISREG(entry.st.st_mode) || entry.st.st_size == 0) {
+        close(fd); //目录等不需要内容，只保留stat结果
+        return true;
+    }
+    if (sendfileMin_ >= 0 && entry.st.st_size >= sendfileMin_) {
+        entry.fd = fd; //大文件保持打开，由sendfile直接从页缓存发送
+        return true;
+    }
+    if (nodes_ > 1) {
+        //分节点时读进自有内存：线程绑定CPU后按内存策略分配在本节点，而共享的页缓存可能在其他节点
+        bool ok = ReadAll_(fd, entry.st.st_size, entry.content);
+        close(fd);
+        if (!ok) {
+            LOG_WARN("read %s failed, errno: %d", path.c_str(), errno);
+            return false;
+        }
+        entry.data = &entry.content[0];
+        return true;
+    }
+    void* mapRet = mmap(nullptr, entry.st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapRet == MAP_FAILED) {
+        LOG_WARN("mmap %s failed, errno: %d", path.c_str(), errno);
+        return false;
+    }
+    entry.data = static_cast<char*>(mapRet);
+    entry.mapped = true;
+    return true;
+}
+
+//压缩版本：先找预先压缩好的同名.br/.gz文件，没有.gz时取压缩仓库中由后台线程生成的gzip版本
+//这里在工作线程上执行（缓存未命中、确认后重新加载、缓存关闭时每次请求），不能压缩
+void FileCache::LoadVariants_(FileEntry& entry) const {
+    for (int i = 0; i < FileEntry::ENC_COUNT; i++) {
+        shared_ptr<FileEntry> variant = make_shared<FileEntry>();
+        if (Open_(entry.path + SIBLING_SUFFIX[i], *variant) && S_ISREG(variant->st.st_mode) && variant->st.st_size > 0) {
+            entry.siblingSt[i] = variant->st;
+            variant->mime = entry.mime;
+            variant->encoding = ENCODING_NAME[i];
+            MakeHeaders_(*variant);
+            entry.variants[i] = variant;
+        }
+    }
+    if (entry.variants[FileEntry::ENC_GZIP] || !Compressible_(entry.mime)) {
+        return;
+    }
+    EntryPtr gzip;
+    {
+        lock_guard<mutex> locker(gzipMtx_);
+        auto it = gzip_.find(entry.path);
+        if (it != gzip_.end() && SameFile_(it->second.src, entry.st)) {
+            gzip = it->second.variant;
+        }
+    }
+    //分节点时仓库中的版本由后台线程生成，不一定在本节点，复制一份
+    entry.variants[FileEntry::ENC_GZIP] = gzip && nodes_ > 1 ? Localize_(gzip) : gzip;
+}
+
+FileCache::EntryPtr FileCache::Localize_(const EntryPtr& src) {
+    shared_ptr<FileEntry> copy = make_shared<FileEntry>();
+    copy->path = src->path;
+    copy->st = src->st;
+    copy->mime = src->mime;
+    copy->encoding = src->encoding;
+    copy->etag = src->etag;
+    copy->lastModified = src->lastModified;
+    copy->validators = src->validators;
+    copy->headers = src->headers;
+    copy->content.assign(src->data, src->st.st_size);
+    copy->data = &copy->content[0];
+    copy->checkedAt.store(src->checkedAt.load(memory_order_relaxed), memory_order_relaxed);
+    return copy;
+}
+
+bool FileCache::BuildGzip_(const string& path) {
+    FileEntry entry;
+    bool compressible = Compressible_(MimeType(path)) && Open_(path, entry) && S_ISREG(entry.st.st_mode)
+                        && entry.st.st_size >= COMPRESS_MIN && entry.st.st_size <= COMPRESS_MAX;
+    struct stat sibling;
+    if (compressible && stat((path + SIBLING_SUFFIX[FileEntry::ENC_GZIP]).c_str(), &sibling) == 0) {
+        compressible = !S_ISREG(sibling.st_mode) || sibling.st_size == 0; //有预先压缩好的.gz就不再压缩
+    }
+    bool changed = false; //丢弃了过期的版本
+    {
+        lock_guard<mutex> locker(gzipMtx_);
+        auto it = gzip_.find(path);
+        if (it != gzip_.end()) {
+            if (compressible && SameFile_(it->second.src, entry.st)) {
+                return false; //文件没有变化
+            }
+            gzipBytes_ -= it->second.variant->content.size();
+            gzip_.erase(it);
+            changed = true;
+        }
+    }
+    if (!compressible) {
+        return changed;
+    }
+    shared_ptr<FileEntry> variant = make_shared<FileEntry>();
+    if (!Compress_(entry, variant->content) || variant->content.size() >= static_cast<size_t>(entry.st.st_size)) {
+        return changed; //压缩失败或压不小
+    }
+    variant->content.shrink_to_fit();
+    //与原文件共享修改时间，ETag在原文件的基础上区分编码
+    variant->path = path;
+    variant->st = entry.st;
+    variant->st.st_size = variant->content.size();
+    variant->data = &variant->content[0];
+    variant->mime = MimeType(path);
+    variant->encoding = ENCODING_NAME[FileEntry::ENC_GZIP];
+    MakeHeaders_(*variant);
+    lock_guard<mutex> locker(gzipMtx_);
+    if (gzipBytes_ + variant->content.size() > GZIP_STORE_MAX) {
+        LOG_WARN("gzip store full (%d KB), %s is served uncompressed", (int)(gzipBytes_ >> 10), path.c_str());
+        return changed;
+    }
+    Compressed& item = gzip_[path];
+    if (item.variant) {
+        gzipBytes_ -= item.variant->content.size(); //另一个后台线程同时压缩了同一个文件
+    }
+    item.src = entry.st;
+    item.variant = variant;
+    gzipBytes_ += variant->content.size();
+    return true;
+}
+
+void FileCache::ClearGzip_() {
+    lock_guard<mutex> locker(gzipMtx_);
+    gzip_.clear();
+    gzipBytes_ = 0;
+}
+
+bool FileCache::Compressible_(const string& mime) {
+    return mime.compare(0, 5, "text/") == 0 || mime == "application/xhtml+xml" || mime == "application/rtf";
+}
+
+bool FileCache::Compress_(const FileEntry& entry, string& out) {
+    size_t size = entry.st.st_size;
+    string content;
+    const char* src = entry.data;
+    if (!src) {
+        //走sendfile的文件没有映射，读出来压缩（在后台线程上）
+        if (!ReadAll_(entry.fd, size, content)) {
+            return false;
+        }
+        src = content.data();
+    }
+    z_stream zs = {};
+    //windowBits加16输出gzip格式；每个版本只压缩一次，且不在请求路径上，用最高压缩级别
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&zs, size));
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(src));
+    zs.avail_in = size;
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = out.size();
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END;
+}
+
+bool FileCache::ReadAll_(int fd, size_t size, string& out) {
+    out.resize(size);
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = pread(fd, &out[got], size - got, got);
+        if (n <= 0) {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+size_t FileCache::Cost_(const FileEntry& entry) {
+    size_t cost = entry.data ? entry.st.st_size : 0;
+    for (const auto& variant : entry.variants) {
+        if (variant) cost += Cost_(*variant);
+    }
+    return cost;
+}
+
+void FileCache::Insert_(Shard& shard, const EntryPtr& entry) {
+    size_t cost = Cost_(*entry);
+    if (shardBudget_ == 0 || cost > shardBudget_) {
+        return; //缓存关闭或单个文件超出预算：不缓存，只给本次请求使用
+    }
+    //淘汰最久未用的项，直到放得下
+    while (!shard.lru.empty() && (shard.bytes + cost > shardBudget_ || shard.index.size() >= MAX_ENTRIES)) {
+        Erase_(shard, prev(shard.lru.end()));
+    }
+    shard.lru.push_front(entry);
+    shard.index[entry->path] = shard.lru.begin();
+    shard.bytes += cost;
+}
+
+void FileCache::Erase_(Shard& shard, list<EntryPtr>::iterator it) {
+    shard.bytes -= Cost_(**it);
+    shard.index.erase((*it)->path);
+    shard.lru.erase(it); //只释放缓存的引用，正在发送的连接仍持有
+}
+
+void FileCache::Clear() {
+    for (int i = 0; i < SHARDS * nodes_; i++) {
+        Shard& shard = shards_[i];
+        lock_guard<mutex> locker(shard.mtx);
+        shard.lru.clear();
+        shard.index.clear();
+        shard.bytes = 0;
+    }
+}
+
+void FileCache::Refresh(const string& path) {
+    BuildGzip_(path);
+    Reload_(path);
+}
+
+void FileCache::Precompress(const string& path) {
+    if (BuildGzip_(path)) {
+        Reload_(path); //已缓存的项还没有gzip版本
+    }
+}
+
+void FileCache::Reload_(const string& path) {
+    bool cached = false;
+    for (int node = 0; node < nodes_; node++) {
+        Shard& shard = ShardOf_(path, node);
+        lock_guard<mutex> locker(shard.mtx);
+        auto it = shard.index.find(path);
+        if (it != shard.index.end()) {
+            Erase_(shard, it->second);
+            cached = true;
+        }
+    }
+    //在调用线程（后台线程）上重新加载，请求不必等待；分节点时由各节点的线程下次请求时在本节点加载
+    if (cached && nodes_ == 1) {
+        Get(path);
+    }
+}
+
+void FileCache::InvalidatePrefix(const string& prefix) {
+    for (int i = 0; i < SHARDS * nodes_; i++) {
+        Shard& shard = shards_[i];
+        lock_guard<mutex> locker(shard.mtx);
+        for (auto it = shard.lru.begin(); it != shard.lru.end();) {
+            auto cur = it++;
+            if ((*cur)->path.compare(0, prefix.size(), prefix) == 0) {
+                Erase_(shard, cur);
+            }
+        }
+    }
+}
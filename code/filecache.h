@@ -0,0 +1,146 @@
+/*
+静态资源的进程级缓存：按完整路径缓存打开的文件，所有连接共享。
+- 每项保存stat结果、MIME类型，以及小文件的内存映射或大文件（走sendfile）的文件描述符；
+- 按路径哈希分成多个分片，每个分片一把锁、一条LRU链，映射总字节数超出预算时淘汰最久未用的项；
+- 调用方拿到的是shared_ptr，响应发完前一直持有，期间即使被淘汰也不会munmap/close；
+- 命中时不做任何系统调用；每项每隔revalidateMs_才stat一次，文件被修改后重新加载
+  （ResourceWatcher用inotify主动刷新时，间隔放宽，只作为兜底）；
+- 压缩版本挂在原文件的项上：优先使用同目录下预先压缩好的.br/.gz文件；
+  没有.gz时，可压缩的文本类型由预热线程或监视线程（Precompress/Refresh）用zlib压缩一次，结果放在单独的压缩仓库中，
+  不受缓存预算影响，加载时按stat结果取用；工作线程加载时从不压缩，仓库中还没有时先发送原文件。
+- 多NUMA节点时（SetNumaNodes）每个节点一组分片，绑定了CPU的线程只查本节点的分片；小文件不再mmap
+  （页缓存不一定在本节点），而是读进加载线程所在节点的内存，压缩仓库中的版本也复制一份，预算按节点平分。
+*/
+
+#ifndef FILECACHE_H
+#define FILECACHE_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <sys/stat.h>
+#include <stdint.h>
+
+#include "log.h"
+
+//一个已打开的静态文件（或它的一个压缩版本），加载后只读
+struct FileEntry {
+    //压缩版本，按优先级排列（br压缩率更高，优先使用）
+    enum ENCODING {
+        ENC_BR = 0,
+        ENC_GZIP,
+        ENC_COUNT,
+    };
+
+    FileEntry() = default;
+    ~FileEntry(); //最后一个持有者释放时才munmap/close
+    FileEntry(const FileEntry&) = delete;
+    FileEntry& operator=(const FileEntry&) = delete;
+
+    std::string path;
+    struct stat st = {};
+    std::string mime; //Content-type（压缩版本与原文件相同）
+    std::string encoding; //Content-Encoding，原文件为空
+    std::string etag; //强校验值，由inode、大小、修改时间生成
+    std::string lastModified; //HTTP日期格式的修改时间
+    std::string validators; //预先生成的ETag、Last-Modified、Cache-Control、Vary响应头（304响应只发这些）
+    std::string headers; //预先生成的Content-type、Content-Encoding、Content-length、Accept-Ranges和validators响应头（不含结尾空行）
+    char* data = nullptr; //小文件的内存映射或压缩结果（空文件为nullptr）
+    bool mapped = false; //data是否为内存映射（否则指向content）
+    std::string content; //自有内存中的内容：后台线程压缩生成的结果，或分节点缓存时读出的文件副本
+    int fd = -1; //大文件的文件描述符，由sendfile直接发送
+    std::shared_ptr<const FileEntry> variants[ENC_COUNT]; //原文件的各个压缩版本，没有为nullptr
+    struct stat siblingSt[ENC_COUNT] = {}; //加载时.br/.gz文件的状态（不存在时st_ino为0），确认是否变化用
+    mutable std::atomic<int64_t> checkedAt{0}; //上次确认文件未变化的时间（毫秒）
+};
+
+class FileCache {
+public:
+    static FileCache* Instance();
+
+    //budgetMB：所有映射合计的字节上限，0表示不缓存；sendfileMin：不小于该大小的文件保持打开走sendfile，负数表示全部映射
+    void Init(int budgetMB, long sendfileMin);
+    //按NUMA节点分别缓存（nodes <= 1 关闭），在Init之后、工作线程开始取文件之前调用
+    void SetNumaNodes(int nodes);
+
+    //取文件，不存在时返回nullptr；返回的项在释放前始终有效
+    std::shared_ptr<const FileEntry> Get(const std::string& path);
+
+    void Clear(); //清空缓存（正在使用的项在释放后关闭）
+    //在后台线程（监视线程、预热线程）上调用：重新生成path的gzip版本放进压缩仓库（不可压缩时丢弃），
+    //已缓存时丢弃旧项并立即重新加载（包括压缩版本）
+    void Refresh(const std::string& path);
+    //在后台线程上调用：path的gzip版本还没有生成或已过期时生成，已缓存的项随之重新加载；文件没变时不做任何事
+    void Precompress(const std::string& path);
+    void InvalidatePrefix(const std::string& prefix); //丢弃路径以prefix开头的所有项（目录被删除/移走）
+    void SetRevalidateMs(int64_t ms) { revalidateMs_.store(ms, std::memory_order_relaxed); }
+
+    //按MIME类型设置Cache-Control的max-age，格式如"text/html=0,image/png=86400,*=3600"
+    //*表示其他类型，没有匹配的类型不发Cache-Control；格式错误时返回false，原设置不变；只在启动时调用
+    bool SetMaxAge(const std::string& spec);
+
+    static std::string MimeType(const std::string& path); //按后缀确定Content-type
+    static const char* EncodingName(int enc); //FileEntry::ENCODING对应的Content-Encoding
+
+private:
+    FileCache();
+    ~FileCache() = default;
+
+    static const int SHARDS = 16;
+    static const int64_t REVALIDATE_MS = 1000; //默认的确认间隔
+    static const size_t MAX_ENTRIES = 1024; //每个分片最多缓存的项数（限制占用的文件描述符）
+    static const off_t COMPRESS_MIN = 256; //太小的文件压缩后省不了多少
+    static const off_t COMPRESS_MAX = 8 << 20; //太大的文件只使用预先压缩好的版本
+    static const size_t GZIP_STORE_MAX = 64 << 20; //压缩仓库的总字节上限
+
+    typedef std::shared_ptr<const FileEntry> EntryPtr;
+    struct Shard {
+        std::mutex mtx;
+        std::list<EntryPtr> lru; //表头最新
+        std::unordered_map<std::string, std::list<EntryPtr>::iterator> index;
+        size_t bytes = 0; //本分片映射的字节数
+    };
+
+    EntryPtr Load_(const std::string& path) const; //open+fstat+mmap，再加载压缩版本，失败返回nullptr
+    bool Open_(const std::string& path, FileEntry& entry) const; //open+fstat，按大小mmap或保持打开
+    void LoadVariants_(FileEntry& entry) const; //打开.br/.gz文件，再从压缩仓库取gzip版本，不做压缩
+    bool BuildGzip_(const std::string& path); //压缩文件并放进压缩仓库（只在后台线程上调用），仓库有变化时返回true
+    void ClearGzip_();
+    static bool Compress_(const FileEntry& entry, std::string& out); //gzip压缩文件内容
+    static bool ReadAll_(int fd, size_t size, std::string& out); //pread读出整个文件
+    static EntryPtr Localize_(const EntryPtr& src); //在当前线程所在节点复制一份内容
+    static bool Compressible_(const std::string& mime);
+    static bool SameFile_(const struct stat& a, const struct stat& b);
+    static bool SiblingsUnchanged_(const FileEntry& entry); //.br/.gz文件有没有被增删改
+    void MakeHeaders_(FileEntry& entry) const; //生成校验值和预先序列化的响应头
+    static size_t Cost_(const FileEntry& entry); //映射和压缩结果占用的字节数（含压缩版本）
+    void Reload_(const std::string& path); //已缓存时丢弃旧项并重新加载
+    void Insert_(Shard& shard, const EntryPtr& entry);
+    void Erase_(Shard& shard, std::list<EntryPtr>::iterator it);
+    Shard& ShardOf_(const std::string& path, int node) {
+        return shards_[node * SHARDS + std::hash<std::string>()(path) % SHARDS];
+    }
+    Shard* LocalShard_(const std::string& path); //当前线程使用的分片，分节点时未绑定CPU的线程返回nullptr
+
+    //压缩仓库中的一项：生成时原文件的stat结果，加载时不一致说明文件已变化，不再使用
+    struct Compressed {
+        struct stat src;
+        EntryPtr variant;
+    };
+
+    std::unique_ptr<Shard[]> shards_; //nodes_ * SHARDS 个分片，按节点分组
+    int nodes_;
+    mutable std::mutex gzipMtx_;
+    std::unordered_map<std::string, Compressed> gzip_; //路径 -> 现场压缩的gzip版本
+    size_t gzipBytes_; //压缩仓库中压缩结果的总字节数
+    size_t budget_; //所有分片合计的字节预算
+    size_t shardBudget_; //每个分片的映射字节预算
+    long sendfileMin_;
+    std::atomic<int64_t> revalidateMs_; //缓存项多久stat确认一次
+    std::unordered_map<std::string, int> maxAge_; //MIME类型 -> max-age（秒），"*"为默认值
+};
+
+#endif
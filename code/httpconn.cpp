@@ -1,16 +1,37 @@
 //管理服务器与单个客户端之间的 “TCP 连接 + HTTP 通信” 全生命周期
 #include "httpconn.h"
+#include "epoller.h"
 #include <errno.h>
+#include <fcntl.h>
 using namespace std;
 
 const char* HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
 bool HttpConn::isET;
+unordered_map<string, HttpConn::StreamRoute> HttpConn::streamRoutes_;
+
+void HttpConn::AddStream(const string& path, const string& contentType, StreamBody::Handler handler) {
+    streamRoutes_[path] = { contentType, std::move(handler) };
+}
 
 HttpConn::HttpConn() {
     fd_ = -1;
     addr_ = { 0 };
+    state_ = CONN_CLOSED;
     isClose_ = true;
+    toWrite_ = 0;
+    outHead_ = 0;
+    responses_ = 0;
+    keepAlive_ = false;
+    moreToRead_ = false;
+    pipe_[0] = pipe_[1] = -1;
+    ready_.conn = this;
+    ring_ = nullptr;
+    ringSending_ = false;
+    ringMem_ = 0;
+    ringFile_ = -1;
+    pipeHeld_ = 0;
+    ringMsg_ = {};
 }
 
 HttpConn::~HttpConn() {
@@ -24,17 +45,40 @@ void HttpConn::Init(int fd, const sockaddr_in& addr) {
     fd_ = fd;
     writeBuff_.RetrieveAll();
     readBuff_.RetrieveAll();
+    request_.Init(); //上一个连接可能在请求解析到一半时关闭
+    //对象随fd复用，清掉上一个连接残留的待发送数据
+    out_.clear();
+    outHead_ = 0;
+    toWrite_ = 0;
+    responses_ = 0;
+    keepAlive_ = false;
+    moreToRead_ = false;
+    producer_ = nullptr;
+    ring_ = nullptr;
+    state_ = CONN_IDLE;
+#ifdef WEBSERVER_COROUTINE
+    co_ = CoState();
+#endif
     isClose_ = false;
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
 }
 
 void HttpConn::Close() {
-    response_.UnmapFile(); //释放响应中通过内存映射的文件资源
+    response_.ReleaseFile(); //释放响应引用的缓存文件
+    out_.clear(); //发送队列中的段同样引用缓存文件
+    outHead_ = 0;
+    toWrite_ = 0;
+    producer_ = nullptr; //生产者可能持有处理函数的资源
+    request_.Init(); //关闭接收到一半的请求体的临时文件
+    ClosePipe_();
+    ringSending_ = false; //发送链已经结束（见Epoller::CloseLater）
+    pipeHeld_ = 0;
     if (isClose_ == false) {
         isClose_ = true;
         userCount--;
-        close(fd_); //close为系统调用函数，关闭客户端socket的文件描述符，释放TCP连接
+        //先记日志再close：fd关闭后可能立刻被其他事件循环accept复用，此后不再访问本对象
         LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
+        close(fd_); //close为系统调用函数，关闭客户端socket的文件描述符，释放TCP连接
     }
 }
 
@@ -43,22 +87,77 @@ int HttpConn::GetFd() const {
 };
 
 struct sockaddr_in HttpConn::GetAddr() const {
+    ResolveAddr_();
     return addr_;
 }
 
+void HttpConn::ResolveAddr_() const {
+    if (addr_.sin_family == AF_UNSPEC && fd_ >= 0) {
+        socklen_t len = sizeof(addr_);
+        if (getpeername(fd_, (struct sockaddr*)&addr_, &len) < 0) {
+            addr_.sin_family = AF_INET; //获取失败也不再重试，按0.0.0.0:0显示
+        }
+    }
+}
+
 const char* HttpConn::GetIP() const {
+    ResolveAddr_();
     //addr_.sin_addr存储的是32位整数形式的 IP 地址
     //ntoa = network to ASCII是系统函数，将整数形式的IP转换为字符串形式
     return inet_ntoa(addr_.sin_addr); //返回客户端的IP地址
 }
 
 int HttpConn::GetPort() const {
+    ResolveAddr_();
     return ntohs(addr_.sin_port); //返回客户端的端口号
 }
 
+bool HttpConn::HasBlockingWork() const {
+    if (request_.Streaming()) {
+        return request_.method() == "POST"; //读缓冲区开头是请求体，请求头已经解析过
+    }
+    return readBuff_.ReadableBytes() >= 4 && memcmp(readBuff_.Peek(), "POST", 4) == 0;
+}
+
+//缓冲区下次读写时重新从空闲链表取块
+void HttpConn::ReleaseBuffers() {
+    if (readBuff_.ReadableBytes() == 0 && writeBuff_.ReadableBytes() == 0) {
+        readBuff_.Release();
+        writeBuff_.Release();
+        std::vector<Segment>().swap(out_); //发送队列此时一定为空
+        outHead_ = 0;
+    }
+}
+
+bool HttpConn::HasInput() const {
+    return readBuff_.ReadableBytes() > 0;
+}
+
+int HttpConn::TakeResponses() {
+    int n = responses_;
+    responses_ = 0;
+    return n;
+}
+
+bool HttpConn::IsIdle() const {
+#ifdef WEBSERVER_COROUTINE
+    return co_.handle && co_.waiting == PENDING_IN && readBuff_.ReadableBytes() == 0;
+#else
+    return state_.load(std::memory_order_acquire) == CONN_IDLE;
+#endif
+}
+
 //从客户端读取数据到缓冲区
 ssize_t HttpConn::read(int* saveErrno) {
     ssize_t len = -1; //存储单次/总读取的字节数，初始化为-1（表示未成功读取）
+    moreToRead_ = false;
+    if (ring_) {
+        return ReadRing_(saveErrno);
+    }
+    //大请求体写入临时文件时，读缓冲区之外的部分直接从socket搬进文件
+    if (request_.SpliceLeft() > 0 && readBuff_.ReadableBytes() == 0) {
+        return SpliceBody_(saveErrno);
+    }
     //循环读取数据（是否循环取决于触发模式）
     do {
         //调用缓冲区的 ReadFd 方法，从 fd_ 读取数据到 readBuff_
@@ -69,77 +168,394 @@ ssize_t HttpConn::read(int* saveErrno) {
         if (len <= 0) {
             break;
         }
+        //读缓冲区不无限增长：先交给解析取走，剩下的数据由MoreToRead()通知调用方接着读
+        if (isET && readBuff_.ReadableBytes() >= READ_LIMIT) {
+            moreToRead_ = true;
+            break;
+        }
     } while (isET); //循环条件：如果是ET模式，则继续读取直到无数据
     return len; //返回读取的总字节数
 }
 
-ssize_t HttpConn::write(int* saveErrno) {
-    ssize_t len = -1; //存储单次/总读取的字节数，初始化为-1（表示未成功读取）
+//socket -> 管道 -> 临时文件，数据不经过用户态；管道只在接收大请求体期间存在
+ssize_t HttpConn::SpliceBody_(int* saveErrno) {
+    if (pipe_[0] < 0 && pipe2(pipe_, O_NONBLOCK | O_CLOEXEC) < 0) {
+        *saveErrno = errno;
+        LOG_ERROR("Create splice pipe failed, errno:%d", errno);
+        return -1;
+    }
+    ssize_t len = -1;
     do {
-        //调用writev系统调用，将iov_中的两个缓冲区数据发送到fd_
-        len = writev(fd_, iov_, iovCnt_);
-        
+        size_t want = request_.SpliceLeft() < SPLICE_CHUNK ? request_.SpliceLeft() : SPLICE_CHUNK;
+        len = splice(fd_, nullptr, pipe_[1], nullptr, want, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
         if (len <= 0) {
-            //发送失败：保存错误码到saveErrno，跳出循环
-            *saveErrno = errno;
-            break; 
-        }
-        //检查是否所有数据都已发送完毕
-        if (iov_[0].iov_len + iov_[1].iov_len  == 0) {
-            break; //传输结束
-        } else if (static_cast<size_t>(len) > iov_[0].iov_len) {
-            //情况1：已发送的数据超过第一个缓冲区（iov_[0]）的长度
-            //调整第二个缓冲区（iov_[1]）的指针和长度：减去已发送的部分
-            iov_[1].iov_base = (uint8_t*) iov_[1].iov_base + (len - iov_[0].iov_len);
-            iov_[1].iov_len -= (len - iov_[0].iov_len);
-            //如果第一个缓冲区有数据，清空并重置
-            if(iov_[0].iov_len) {
-                writeBuff_.RetrieveAll();
-                iov_[0].iov_len = 0;
+            *saveErrno = len < 0 ? errno : 0; //0：对端关闭
+            break;
+        }
+        //每次都把管道排空，管道容量（64KB）不会成为限制
+        for (ssize_t moved = 0; moved < len; ) {
+            ssize_t n = splice(pipe_[0], nullptr, request_.BodyFd(), nullptr, len - moved, SPLICE_F_MOVE);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                *saveErrno = n < 0 ? errno : EIO;
+                LOG_ERROR("Spool request body failed, errno:%d", *saveErrno);
+                return -1;
+            }
+            moved += n;
+        }
+        request_.BodySpliced(len);
+    } while (isET && request_.SpliceLeft() > 0);
+    if (request_.SpliceLeft() == 0) {
+        ClosePipe_();
+        moreToRead_ = isET; //请求体收完就停下，后面流水线上的请求还在socket中
+    }
+    return len;
+}
+
+void HttpConn::ClosePipe_() {
+    if (pipe_[0] >= 0) {
+        close(pipe_[0]);
+        close(pipe_[1]);
+        pipe_[0] = pipe_[1] = -1;
+    }
+}
+
+ssize_t HttpConn::write(int* saveErrno) {
+    if (ring_) {
+        return WriteRing_(saveErrno);
+    }
+    ssize_t len = -1; //存储单次/总读取的字节数，初始化为-1（表示未成功读取）
+    while (true) {
+        if (producer_ && toWrite_ < STREAM_LOW_WATER) {
+            Produce_(); //发送队列快空了：流式响应接着生产（队列积压时不调用，即背压）
+        }
+        if (toWrite_ == 0) {
+            break; //全部发完，流式响应也已结束
+        }
+        Segment& front = out_[outHead_];
+        if (front.kind == SEG_FILE) {
+            //sendfile：文件内容由内核直接从页缓存发出
+            //front.offset由sendfile推进，EAGAIN返回后下次从断点继续（ET/LT相同）
+            len = sendfile(fd_, front.fd, &front.offset, front.len);
+            if (len <= 0) {
+                *saveErrno = errno; //返回0说明文件被截短，按发送失败处理
+                break;
             }
         } else {
-            //情况2：已发送的数据未超过第一个缓冲区的长度
-            //调整第一个缓冲区的指针和长度：减去已发送的部分
-            iov_[0].iov_base = (uint8_t*)iov_[0].iov_base + len; 
-            iov_[0].iov_len -= len; 
-            writeBuff_.Retrieve(len); //从写缓冲区中移除已发送的数据
+            //从队头开始把连续的内存段（响应头、段头、内存中的文件内容）合并成一次发送，
+            //流水线上多个小响应一起发出；后面紧跟sendfile的文件时加MSG_MORE，让内核和文件开头合并成满的报文段
+            struct iovec iov[MAX_IOV];
+            int cnt = 0;
+            bool fileFollows = false;
+            size_t buffOff = 0;
+            for (size_t i = outHead_; i < out_.size() && cnt < MAX_IOV; i++) {
+                const Segment& seg = out_[i];
+                if (seg.kind == SEG_FILE) {
+                    fileFollows = true;
+                    break;
+                }
+                if (seg.kind == SEG_BUFF) {
+                    //写缓冲区中的段按顺序紧挨着存放，直接沿块链取iovec，不合并写缓冲区
+                    cnt += writeBuff_.PeekIov(buffOff, seg.len, iov + cnt, MAX_IOV - cnt);
+                    buffOff += seg.len;
+                    continue;
+                }
+                iov[cnt].iov_base = const_cast<char*>(seg.data);
+                iov[cnt].iov_len = seg.len;
+                cnt++;
+            }
+            struct msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = cnt;
+            len = sendmsg(fd_, &msg, MSG_NOSIGNAL | (fileFollows ? MSG_MORE : 0));
+            if (len <= 0) {
+                //发送失败：保存错误码到saveErrno，跳出循环
+                *saveErrno = errno;
+                break;
+            }
         }
-    } while (isET || ToWriteBytes() > 10240); //循环条件：ET模式或剩余数据量较大
+        Advance_(len);
+        if (!isET && toWrite_ <= 10240 && !producer_) {
+            break; //LT模式：剩余数据不多时交给下一次可写事件
+        }
+    }
     return len;
 }
 
-bool HttpConn::process() {
-    //步骤1：初始化请求对象
-    request_.Init();
+//io_uring：数据已由multishot recv收进缓冲区环，从中复制到读缓冲区（请求体同样经过读缓冲区，不走SpliceBody_）
+ssize_t HttpConn::ReadRing_(int* saveErrno) {
+    ssize_t len = -1;
+    do {
+        readBuff_.EnsureWritable(1);
+        len = ring_->Recv(fd_, readBuff_.BeginWrite(), readBuff_.WritableBytes(), saveErrno);
+        if (len <= 0) {
+            break;
+        }
+        readBuff_.HasWritten(len);
+        if (isET && readBuff_.ReadableBytes() >= READ_LIMIT) {
+            moreToRead_ = true;
+            break;
+        }
+    } while (isET);
+    return len;
+}
+
+//io_uring：发送队列提交成发送链，发送链完成（EPOLLOUT事件）后再调用本函数取回结果、提交下一条
+//发送链在途时返回-1且错误码为EAGAIN，由调用方等待可写事件
+ssize_t HttpConn::WriteRing_(int* saveErrno) {
+    ssize_t len = 0;
+    if (ringSending_) {
+        Epoller::SendResult res;
+        if (!ring_->TakeSent(fd_, &res)) {
+            *saveErrno = EAGAIN;
+            return -1;
+        }
+        ringSending_ = false;
+        //文件段的offset记录读进管道的进度，len记录送到socket的进度，两者之差留在管道中
+        size_t fileSent = res.sent > ringMem_ ? res.sent - ringMem_ : 0;
+        if (ringFile_ >= 0) {
+            out_[ringFile_].offset += res.piped;
+        }
+        pipeHeld_ = pipeHeld_ + res.piped - fileSent;
+        if (res.sent > 0) {
+            Advance_(res.sent);
+        }
+        if (res.err) {
+            *saveErrno = res.err;
+            return -1;
+        }
+        len = res.sent;
+    }
+    if (producer_ && toWrite_ < STREAM_LOW_WATER) {
+        Produce_();
+    }
+    if (toWrite_ == 0) {
+        return len;
+    }
+    if (!SubmitRing_(saveErrno)) {
+        return -1;
+    }
+    *saveErrno = EAGAIN;
+    return -1;
+}
 
-    //步骤2：检查读缓冲区是否有数据（没有数据则无法处理）
-    if (readBuff_.ReadableBytes() <= 0) {
+bool HttpConn::SubmitRing_(int* saveErrno) {
+    Epoller::SendChain chain;
+    int cnt = 0;
+    size_t want = 0, buffOff = 0;
+    size_t i = outHead_;
+    for (; i < out_.size() && out_[i].kind != SEG_FILE && cnt < MAX_IOV; i++) {
+        const Segment& seg = out_[i];
+        want += seg.len;
+        if (seg.kind == SEG_BUFF) {
+            cnt += writeBuff_.PeekIov(buffOff, seg.len, ringIov_ + cnt, MAX_IOV - cnt);
+            buffOff += seg.len;
+            continue;
+        }
+        ringIov_[cnt].iov_base = const_cast<char*>(seg.data);
+        ringIov_[cnt].iov_len = seg.len;
+        cnt++;
+    }
+    ringMem_ = 0;
+    for (int k = 0; k < cnt; k++) {
+        ringMem_ += ringIov_[k].iov_len;
+    }
+    if (cnt > 0) {
+        ringMsg_ = {};
+        ringMsg_.msg_iov = ringIov_;
+        ringMsg_.msg_iovlen = cnt;
+        chain.msg = &ringMsg_;
+    }
+    //内存段全部放进了iovec，紧跟的文件段接在同一条链后面
+    ringFile_ = -1;
+    if (ringMem_ == want && i < out_.size() && out_[i].kind == SEG_FILE) {
+        Segment& seg = out_[i];
+        assert(pipeHeld_ == 0 || cnt == 0); //管道中的剩余数据只属于队头的文件段
+        if (pipe_[0] < 0 && pipe2(pipe_, O_CLOEXEC) < 0) {
+            *saveErrno = errno;
+            LOG_ERROR("Create splice pipe failed, errno:%d", errno);
+            return false;
+        }
+        chain.fileFd = seg.fd;
+        chain.offset = seg.offset;
+        size_t left = seg.len - pipeHeld_;
+        chain.fileLen = left < RING_FILE_LIMIT ? left : RING_FILE_LIMIT;
+        chain.pipeRd = pipe_[0];
+        chain.pipeWr = pipe_[1];
+        chain.drain = pipeHeld_;
+        ringFile_ = static_cast<int>(i);
+    }
+    if (!ring_->Send(fd_, chain)) {
+        *saveErrno = EIO;
+        LOG_ERROR("Client[%d] submit send chain failed", fd_);
         return false;
-    } else if (request_.parse(readBuff_)) {
-        //步骤3：解析读缓冲区中的HTTP请求
-        LOG_DEBUG("%s", request_.path().c_str());
-        //初始化响应：200表示成功，根据请求决定是否保持连接
-        response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);
-    } else {
-        //解析失败：返回400错误（Bad Request），且不保持连接
-        response_.Init(srcDir, request_.path(), false, 400);
-    }
-    //步骤4：生成响应报文，写入写缓冲区（响应头+部分响应体）
-    response_.MakeResponse(writeBuff_);
-
-    //步骤5：绑定响应头到iov_[0]（准备发送）
-    iov_[0].iov_base = const_cast<char*>(writeBuff_.Peek()); //指向响应头数据
-    iov_[0].iov_len = writeBuff_.ReadableBytes(); //响应头长度
-    iovCnt_ = 1;
-
-    //步骤6：如果有响应体（文件），绑定到iov_[1]
-    if(response_.FileLen() > 0  && response_.File()) {
-        iov_[1].iov_base = response_.File();
-        iov_[1].iov_len = response_.FileLen();
-        iovCnt_ = 2;
-    }
-    //打印调试日志：文件大小、缓冲区数量、总待发送字节数
-    LOG_DEBUG("filesize:%d, %d  to %d", response_.FileLen() , iovCnt_, ToWriteBytes());
+    }
+    ringSending_ = true;
     return true;
 }
 
+//发送了n字节：从队头依次扣除，发完的段释放对缓存文件的引用（被淘汰的文件不会因空闲长连接而迟迟不关闭）
+void HttpConn::Advance_(size_t n) {
+    toWrite_ -= n;
+    while (n > 0) {
+        Segment& seg = out_[outHead_];
+        size_t k = min(n, seg.len);
+        if (seg.kind == SEG_BUFF) {
+            writeBuff_.Retrieve(k);
+        } else if (seg.kind == SEG_MEM) {
+            seg.data += k;
+        } //SEG_FILE的偏移已由sendfile（或WriteRing_）推进
+        seg.len -= k;
+        n -= k;
+        if (seg.len == 0) {
+            seg.file.reset();
+            outHead_++;
+        }
+    }
+    if (outHead_ == out_.size()) {
+        out_.clear();
+        outHead_ = 0;
+    }
+}
+
+//追加一段到发送队列；相邻的写缓冲区段合并成一段
+void HttpConn::Enqueue_(int kind, const char* data, int fd, off_t offset, size_t len,
+                        const std::shared_ptr<const FileEntry>& file) {
+    if (len == 0) {
+        return;
+    }
+    toWrite_ += len;
+    if (kind == SEG_BUFF && out_.size() > outHead_ && out_.back().kind == SEG_BUFF) {
+        out_.back().len += len;
+        return;
+    }
+    Segment seg;
+    seg.kind = kind;
+    seg.data = data;
+    seg.fd = fd;
+    seg.offset = offset;
+    seg.len = len;
+    seg.file = file;
+    out_.push_back(std::move(seg));
+}
+
+//把刚生成的响应（响应头已追加到写缓冲区的headLen字节）和它的响应体排入发送队列
+void HttpConn::EnqueueResponse_(size_t headLen) {
+    Enqueue_(SEG_BUFF, nullptr, -1, 0, headLen, nullptr);
+    const std::shared_ptr<const FileEntry>& file = response_.FilePtr();
+    //206响应按段发送：段头（分隔行）追加到写缓冲区，文件区间直接引用
+    //其他响应：小文件引用内存映射（或压缩结果），大文件记录sendfile的起点和长度
+    std::vector<HttpResponse::BodyRange> whole;
+    const std::vector<HttpResponse::BodyRange>* parts = &response_.Ranges();
+    if (parts->empty()) {
+        whole.push_back({ "", 0, response_.FileLen() });
+        parts = &whole;
+    }
+    for (const auto& part : *parts) {
+        writeBuff_.Append(part.head);
+        Enqueue_(SEG_BUFF, nullptr, -1, 0, part.head.size(), nullptr);
+        if (part.len == 0) {
+            continue;
+        }
+        if (response_.File()) {
+            Enqueue_(SEG_MEM, response_.File() + part.start, -1, 0, part.len, file);
+        } else if (response_.FileFd() >= 0) {
+            Enqueue_(SEG_FILE, nullptr, response_.FileFd(), part.start, part.len, file);
+        }
+    }
+    response_.ReleaseFile(); //发送队列已持有文件的引用
+}
+
+void HttpConn::StartStream_(const StreamRoute& route) {
+    //HTTP/1.0不支持分块编码，只能以关闭连接表示响应结束
+    bool chunked = request_.version() == "1.1";
+    if (!chunked) {
+        keepAlive_ = false;
+    }
+    response_.Init(srcDir, request_.path(), keepAlive_, 200);
+    size_t before = writeBuff_.ReadableBytes();
+    response_.MakeStreamHead(writeBuff_, route.contentType, chunked);
+    Enqueue_(SEG_BUFF, nullptr, -1, 0, writeBuff_.ReadableBytes() - before, nullptr);
+    stream_.Begin_(&writeBuff_, chunked);
+    producer_ = route.handler(request_);
+    if (!producer_) {
+        stream_.End_(); //没有响应体
+        Enqueue_(SEG_BUFF, nullptr, -1, 0, stream_.TakeFramed_(), nullptr);
+    }
+}
+
+void HttpConn::Produce_() {
+    while (producer_) {
+        if (!producer_(stream_)) {
+            stream_.End_();
+            producer_ = nullptr;
+        }
+        bool flush = stream_.TakeFlush_();
+        Enqueue_(SEG_BUFF, nullptr, -1, 0, stream_.TakeFramed_(), nullptr);
+        if (flush || toWrite_ >= STREAM_HIGH_WATER) {
+            break;
+        }
+    }
+}
+
+bool HttpConn::process() {
+    //流水线：读缓冲区中所有完整的请求依次解析，响应按顺序排入发送队列，一起发送
+    //每批最多MAX_PIPELINE个；剩下的在这一批发完后继续处理（它们不会再触发可读事件）
+    int queued = 0;
+    //大请求体的最后一段由splice直接搬进了文件，读缓冲区为空时也要让解析收尾
+    while (queued < MAX_PIPELINE
+           && (readBuff_.ReadableBytes() > 0 || (request_.Streaming() && request_.SpliceLeft() == 0))) {
+        //需要访问数据库的请求（协程模式下要先切到线程池）单独成批
+        if (queued > 0 && HasBlockingWork()) {
+            break;
+        }
+        bool streamed = false;
+        //解析读缓冲区中的HTTP请求，接着上次的进度继续
+        HttpRequest::PARSE_RESULT parsed = request_.parse(readBuff_);
+        if (parsed == HttpRequest::PARSE_AGAIN) {
+            //请求还没收完：已解析的部分保留在request_中，数据留在读缓冲区，等待更多数据
+            break;
+        } else if (parsed == HttpRequest::PARSE_OK) {
+            //请求完整
+            LOG_DEBUG("%s", request_.path().c_str());
+            //初始化响应：200表示成功，根据请求决定是否保持连接
+            keepAlive_ = request_.IsKeepAlive();
+            auto route = streamRoutes_.find(request_.path());
+            if (route != streamRoutes_.end()) {
+                //流式响应：处理函数可能用到请求头，要在取走请求之前调用
+                StartStream_(route->second);
+                streamed = true;
+            } else {
+                response_.Init(srcDir, request_.path(), keepAlive_, 200);
+            }
+            if (!streamed && request_.method() == "GET") {
+                response_.SetConditional(request_.Header(HttpRequest::HDR_IF_NONE_MATCH),
+                                         request_.Header(HttpRequest::HDR_IF_MODIFIED_SINCE));
+                response_.SetEncoding(request_.Header(HttpRequest::HDR_ACCEPT_ENCODING));
+                response_.SetRange(request_.Header(HttpRequest::HDR_RANGE), request_.Header(HttpRequest::HDR_IF_RANGE));
+            }
+            //请求头是在读缓冲区上原地解析的，用完后才取走本请求的字节
+            readBuff_.Retrieve(request_.Consumed());
+        } else {
+            //解析失败：返回400错误（Bad Request，请求体过大时413），且不保持连接
+            keepAlive_ = false;
+            response_.Init(srcDir, request_.path(), false, request_.ErrorCode());
+            request_.Init(); //丢弃解析到一半的请求
+            readBuff_.RetrieveAll();
+        }
+        //生成响应报文：响应头追加到写缓冲区，响应体排入发送队列
+        if (!streamed) {
+            size_t before = writeBuff_.ReadableBytes();
+            response_.MakeResponse(writeBuff_);
+            EnqueueResponse_(writeBuff_.ReadableBytes() - before);
+        }
+        queued++;
+        responses_++;
+        if (!keepAlive_ || producer_) {
+            break; //发完这个响应就关闭连接，后面的请求不再处理；流式响应结束之前后面的请求也要等待
+        }
+    }
+    //打印调试日志：本批响应数、队列段数、总待发送字节数
+    LOG_DEBUG("pipelined:%d, %d segments to %d", queued, (int)(out_.size() - outHead_), (int)toWrite_);
+    return queued > 0;
+}
@@ -11,23 +11,60 @@
 
 #include <sys/types.h>
 #include <sys/uio.h>  //提供readv/writev函数（分散读写）
+#include <sys/socket.h> //sendmsg
+#include <sys/sendfile.h>
 #include <arpa/inet.h> //提供sockaddr_in结构体（IPv4 地址）
 #include <errno.h>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
 
 #include "log.h"
 #include "buffer.h"
 #include "httprequest.h"
 #include "httpresponse.h"
+#include "streambody.h"
+#include "task.h"
+#include "conncoroutine.h"
+
+class Epoller;
 
 //进行读写数据并调用httprequest 来解析数据以及httpresponse来生成响应
 
 class HttpConn {
 public:
+    //连接状态机：状态字低8位为当前状态，高位记录工作线程处理期间到达、尚未处理的事件
+    //事件循环负责把空闲/等待中的连接认领为PROCESSING并投递任务，工作线程处理完后回写下一个状态
+    enum CONN_STATE {
+        CONN_IDLE = 0, //长连接空闲，等待下一个请求
+        CONN_READING, //请求未读完，等待可读
+        CONN_PROCESSING, //工作线程正在读取/解析/发送
+        CONN_WRITING, //响应未发完（发送缓冲区已满），等待可写
+        CONN_CLOSED, //已关闭
+    };
+    static const uint32_t STATE_MASK = 0xff;
+    static const uint32_t PENDING_IN = 1u << 8; //处理期间到达的可读事件
+    static const uint32_t PENDING_OUT = 1u << 9; //处理期间到达的可写事件
+    static const uint32_t PENDING_CLOSE = 1u << 10; //处理期间到达的关闭请求（对端挂断/超时）
+
+    //嵌入连接对象的就绪任务节点：事件循环认领连接后直接把它投递给线程池，分发过程不分配内存
+    //状态机保证同一时刻最多只有一个工作线程持有连接，节点执行完之前不会被再次投递
+    struct ReadyTask : TaskNode {
+        HttpConn* conn = nullptr; //所属连接
+        void* owner = nullptr; //投递方上下文（所属事件循环）
+        uint32_t gen = 0; //投递时连接的代数
+        int action = 0; //要执行的动作
+    };
+
     HttpConn();
     ~HttpConn();
     //sockaddr_in 是TCP/IP网络编程中专门用于描述“IPv4 地址和端口”的结构体
     //核心作用是给网络通信的两端贴个详细地址标签，让数据能准确找到要发往的目标
     void Init(int sockFd, const sockaddr_in& addr);
+    //io_uring后端的连接（Epoller::RingIo）：收发不再直接读写socket，改由epoller的缓冲区环和发送链完成
+    void UseRing(Epoller* epoller) { ring_ = epoller; }
 
     ssize_t read(int* saveErrno);
     ssize_t write(int* saveErrno);
@@ -42,13 +79,38 @@ public:
 
     //返回待发送的字节数（用于判断是否还有数据未发送）
     size_t ToWriteBytes() {
-        return static_cast<size_t>(iov_[0].iov_len) + static_cast<size_t>(iov_[1].iov_len);
+        return toWrite_;
     }
 
     bool IsKeepAlive() const {
-        return request_.IsKeepAlive();
+        return keepAlive_; //最后排入发送队列的响应是否保持连接
     }
 
+    //在path上注册流式响应（见StreamBody），必须在服务器启动前注册
+    static void AddStream(const std::string& path, const std::string& contentType, StreamBody::Handler handler);
+
+    bool HasInput() const; //读缓冲区中是否还有未处理的数据（流水线上后续的请求）
+    //上次read没有读到EAGAIN就停下了（ET模式读满READ_LIMIT或大请求体收完），不会再有可读事件，需要接着读
+    bool MoreToRead() const { return moreToRead_; }
+    int TakeResponses(); //取走上次调用以来排入发送队列的响应数（请求计数用）
+
+    std::atomic<uint32_t>& State() { return state_; }
+    ReadyTask& Ready() { return ready_; }
+    bool HasBlockingWork() const; //读缓冲区中的请求是否需要阻塞操作（POST登录/注册会访问数据库）
+    void ReleaseBuffers(); //长连接空闲时归还读写缓冲区的内存（缓冲区中还有数据时不归还）
+    bool IsIdle() const; //是否空闲（没有未处理完的请求），内存超出预算时只淘汰空闲连接
+
+#ifdef WEBSERVER_COROUTINE
+    //协程模式下连接的调度状态（只由所属事件循环线程访问）
+    struct CoState {
+        std::coroutine_handle<> handle; //驱动该连接的协程
+        uint32_t waiting = 0; //协程挂起等待的事件（PENDING_IN/PENDING_OUT）
+        uint32_t pending = 0; //协程没有等待时到达的事件，下次等待时直接返回
+        bool closing = false; //对端挂断/超时，协程恢复后退出
+    };
+    CoState& Co() { return co_; }
+#endif
+
     //边缘触发ET 还是水平触发LT
     //LT（水平触发）：只要缓冲区有数据未读，就会持续触发事件
     //ET（边缘触发）：仅在数据 “刚到达时” 触发一次事件
@@ -58,19 +120,79 @@ public:
 
 
 private:
+    void ResolveAddr_() const; //accept时未拿到对端地址（io_uring后端），用到时再getpeername
+
+    //发送队列中的一段：写缓冲区中的字节、内存中的文件内容或用sendfile发送的文件区间
+    enum SEG_KIND {
+        SEG_BUFF = 0, //写缓冲区中接下来的len字节（响应头、206的段头）
+        SEG_MEM, //内存映射的小文件或压缩结果中的[data, data+len)
+        SEG_FILE, //fd中[offset, offset+len)，用sendfile发送
+    };
+    struct Segment {
+        int kind;
+        const char* data;
+        int fd;
+        off_t offset; //sendfile从这里继续（EAGAIN后保留进度）
+        size_t len; //剩余字节数
+        std::shared_ptr<const FileEntry> file; //发完之前保持缓存文件（及其映射、fd）有效
+    };
+    static const int MAX_PIPELINE = 16; //一批最多处理的流水线请求数
+    static const int MAX_IOV = 64; //一次sendmsg最多合并的段数
+    static const size_t STREAM_LOW_WATER = 16 * 1024; //发送队列低于这个字节数时让流式响应继续生产
+    static const size_t STREAM_HIGH_WATER = 64 * 1024; //生产到这个字节数就先发送
+    static const size_t READ_LIMIT = 256 * 1024; //ET模式一次读到读缓冲区中的数据上限
+    static const size_t SPLICE_CHUNK = 64 * 1024; //一次splice的字节数（管道的默认容量）
+
+    void Enqueue_(int kind, const char* data, int fd, off_t offset, size_t len,
+                  const std::shared_ptr<const FileEntry>& file);
+    void EnqueueResponse_(size_t headLen);
+    void Advance_(size_t n); //发送了n字节后推进发送队列
+    struct StreamRoute {
+        std::string contentType;
+        StreamBody::Handler handler;
+    };
+    static std::unordered_map<std::string, StreamRoute> streamRoutes_; //启动后只读
+    void StartStream_(const StreamRoute& route); //流式响应：响应头排入队列，之后由write按需调用生产者
+    void Produce_(); //调用生产者，直到达到高水位、要求立即发送或响应结束
+    ssize_t SpliceBody_(int* saveErrno); //把请求体直接从socket搬进临时文件
+    void ClosePipe_();
+    ssize_t ReadRing_(int* saveErrno);
+    ssize_t WriteRing_(int* saveErrno);
+    bool SubmitRing_(int* saveErrno); //把发送队列开头的内存段和随后的文件段提交成一条发送链
+    static const size_t RING_FILE_LIMIT = 1024 * 1024; //一条发送链最多发送的文件字节数
+
+    //热数据放在对象开头（fd、状态、待发送字节数共同落在第一条缓存行），事件分发和写回只触碰这里
     int fd_; //客户端socket的文件描述符（唯一标识连接），一个fd就是一个客户端
-    struct sockaddr_in addr_; //客户端的IP地址和端口信息
-
+    std::atomic<uint32_t> state_; //状态机（见CONN_STATE）
     bool isClose_;
-
-    int iovCnt_; //分散读写的缓冲区数量（通常为 2）
-
-    //用于writev函数的分散缓冲区
-    struct iovec iov_[2]; ////iov_[0]指向响应头缓冲区，iov_[1]指向响应体
+    bool keepAlive_; //最后排队的响应是否保持连接
+    bool moreToRead_;
+    int responses_; //排入队列、尚未计数的响应数
+    size_t toWrite_; //发送队列中的总字节数
+    size_t outHead_; //发送队列中第一个未发完的段
+    std::vector<Segment> out_; //按顺序发送的段，流水线上多个响应依次排在一起
+    int pipe_[2]; //splice用的管道，-1表示没有
+    ReadyTask ready_; //就绪任务节点
+    Epoller* ring_; //RingIo时为所属的epoller，否则为nullptr
+    bool ringSending_; //发送链已提交、结果还没有取回
+    size_t ringMem_; //发送链中内存段的字节数
+    int ringFile_; //发送链中文件段在out_中的下标，没有文件段时为-1
+    size_t pipeHeld_; //文件已读进管道、还没有送到socket的字节数（发送链中途断开时留下）
+    struct iovec ringIov_[MAX_IOV]; //发送链完成之前内核一直引用
+    struct msghdr ringMsg_;
+#ifdef WEBSERVER_COROUTINE
+    CoState co_;
+#endif
+
+    //冷数据：地址、缓冲区、请求/响应对象
+    mutable struct sockaddr_in addr_; //客户端的IP地址和端口信息
 
     Buffer readBuff_;
     Buffer writeBuff_;
 
+    StreamBody::Producer producer_; //正在发送的流式响应的生产者，没有时为空
+    StreamBody stream_;
+
     HttpRequest request_;
     HttpResponse response_;
 
@@ -1,7 +1,15 @@
 #include "httprequest.h"
 #include <algorithm>
+#include <ctype.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
 using namespace std;
 
+size_t HttpRequest::maxBodySize = 1 << 20;
+size_t HttpRequest::spoolSize = 64 << 10;
+
 //服务器默认支持的HTML页面路径
 //快速判断某个请求路径是否是 “默认 HTML 页面”
 const unordered_set<string> HttpRequest::DEFAULT_HTML {
@@ -13,72 +21,351 @@ const unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG {
     {"/register.html", 0}, {"/login.html", 1}, 
 };
 
+//RFC 7230 token字符（方法名、字段名）：字母数字和 !#$%&'*+-.^_`|~
+static const struct TokenTable {
+    bool ok[256];
+    TokenTable() : ok() {
+        for (int c = '0'; c <= '9'; c++) ok[c] = true;
+        for (int c = 'a'; c <= 'z'; c++) ok[c] = ok[c - 'a' + 'A'] = true;
+        for (const char* p = "!#$%&'*+-.^_`|~"; *p; p++) ok[static_cast<unsigned char>(*p)] = true;
+    }
+} TOKEN;
+
+static inline bool IsToken(char c) {
+    return TOKEN.ok[static_cast<unsigned char>(c)];
+}
+
+//请求目标：可见ASCII字符
+static inline bool IsTargetChar(char c) {
+    unsigned char u = static_cast<unsigned char>(c);
+    return u > 0x20 && u < 0x7f;
+}
+
+HttpRequest::~HttpRequest() {
+    if (bodyFd_ >= 0) {
+        close(bodyFd_);
+    }
+}
+
 void HttpRequest::Init() {
     method_ = path_ = version_ = body_ = "";
     state_ = REQUEST_LINE;
-    header_.clear();
+    base_ = nullptr;
+    pos_ = scan_ = headEnd_ = contentLen_ = 0;
+    bodyLeft_ = bodySize_ = 0;
+    if (bodyFd_ >= 0) {
+        close(bodyFd_); //临时文件创建后就已删除，关闭即释放
+        bodyFd_ = -1;
+    }
+    error_ = 400;
+    head_.clear();
+    fields_.clear(); //保留容量，长连接上的后续请求不再分配
+    fill(hot_, hot_ + HDR_COUNT, -1);
+    keepAlive_ = false;
+    consumed_ = 0;
     post_.clear();
 }
 
-//判断是否需要长连接，两个条件：
-//请求头中存在 Connection: keep-alive
-//HTTP 版本是 1.1
+//判断是否需要长连接：
+//HTTP/1.1 默认保持连接，除非 Connection 中有 close
+//HTTP/1.0 只有 Connection 中有 keep-alive 时才保持
 bool HttpRequest::IsKeepAlive() const {
-    if (header_.count("Connection") == 1) {
-        return header_.find("Connection")->second == "keep-alive" && version_ == "1.1"; 
-    }
-    return false;
+    return keepAlive_;
 }
 
 //核心解析函数
-//从缓冲区buff中读取 HTTP 请求数据，按状态逐步解析
-bool HttpRequest::parse(Buffer& buff) {
-    const char CRLF[] = "\r\n"; //行结束标志
-    if (buff.ReadableBytes() <= 0) { //没有可读字节
-        return false;
+//有限状态机：请求行 -> 请求头（直到空行）-> 请求体，每个元素完整到达后才解析，不完整时保留进度返回PARSE_AGAIN
+HttpRequest::PARSE_RESULT HttpRequest::parse(Buffer& buff) {
+    if (state_ == FINISH) {
+        Init(); //上一个请求已经处理完，开始解析下一个
     }
-
-    //读取数据
-    //循环条件：缓冲区有可读数据，且解析状态未完成（state_ != FINISH）
-    while (buff.ReadableBytes() && state_ != FINISH) {
-        //按行分割的流式数据
-        //步骤1：查找当前行的结束位置,四个参数都是指针
-        const char* lineEnd = search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
-        //步骤2：提取当前行的内容（从缓冲区当前位置到lineEnd，不包含CRLF）
-        std::string line(buff.Peek(), lineEnd);
+    if (Streaming()) {
+        return ParseStream_(buff); //请求头已复制出去，读缓冲区开头就是请求体
+    }
+    const size_t size = buff.ReadableBytes();
+    base_ = buff.Peek();
+    const char* end = base_ + size;
+    if (headEnd_ == 0) {
+        //请求行之前的空行（如上一个请求体后面多发的CRLF）直接跳过，它们不是请求头的结束
+        while (size - pos_ >= 2 && base_[pos_] == '\r' && base_[pos_ + 1] == '\n') {
+            pos_ += 2;
+        }
+        scan_ = max(scan_, pos_);
+        //整个请求头到齐之前不按行切分：用SIMD查找空行，从上次扫描到的位置继续
+        const char* headEnd = CharScan::FindHeadEnd(base_ + scan_, end);
+        if (headEnd == end) {
+            if (size > MAX_HEAD) {
+                LOG_ERROR("Request head too large");
+                return PARSE_ERROR;
+            }
+            scan_ = max(pos_, size >= 3 ? size - 3 : 0); //最后三个字节可能是"\r\n\r"
+            return PARSE_AGAIN;
+        }
+        headEnd_ = headEnd + 4 - base_;
+        if (headEnd_ > MAX_HEAD) {
+            LOG_ERROR("Request head too large");
+            return PARSE_ERROR;
+        }
+        scan_ = pos_;
+    }
+    while (state_ != FINISH) {
+        if (state_ == BODY) {
+            //状态3：请求体，整个到齐后才解析
+            if (size - pos_ < contentLen_) {
+                return PARSE_AGAIN;
+            }
+            ParseBody_(base_ + pos_, contentLen_);
+            pos_ += contentLen_;
+            state_ = FINISH;
+            break;
+        }
+        //请求头已经完整：按行切分，最后一行是headEnd_之前的空行
+        const char* line = base_ + pos_;
+        const char* lineEnd = CharScan::FindCrlf(line, base_ + headEnd_);
+        assert(lineEnd != base_ + headEnd_);
+        pos_ = lineEnd + 2 - base_;
         switch (state_) {
-            //有限状态机，从请求行开始，每处理完后会自动转入到下一个状态
             case REQUEST_LINE: //状态1：解析请求行
-                if (!ParseRequestLine_(line)) {
-                    return false;
+                if (line == lineEnd) {
+                    break; //请求行之前的空行（如上一个请求体后面多发的CRLF）直接忽略
+                }
+                if (!ParseRequestLine_(line, lineEnd)) {
+                    return PARSE_ERROR;
                 }
                 ParsePath_();
                 break;
-            case HEADERS: //状态2：解析请求头
-                ParseHeader_(line);
-                //检查请求头是否解析完毕：请求头结束后会有一个空行（仅CRLF）
-                //此时缓冲区剩余可读字节 <= 2（刚好一个CRLF），说明请求头结束
-                if (buff.ReadableBytes() <= 2) {
-                    state_ = FINISH;
+            case HEADERS: //状态2：解析请求头，遇到空行时请求头结束
+                if (line == lineEnd) {
+                    if (!FinishHeaders_()) {
+                        return PARSE_ERROR;
+                    }
+                    if (Streaming()) {
+                        DetachHead_(buff);
+                        return ParseStream_(buff);
+                    }
+                } else if (!ParseHeader_(line, lineEnd)) {
+                    return PARSE_ERROR;
                 }
                 break;
-            case BODY: //状态3：解析请求体
-                ParseBody_(line);
-                break;
-            case FINISH: //状态4：已完成解析
-                break;
             default:
                 break;
         }
-        //步骤4：判断是否已读完缓冲区数据
-        //lineEnd 等于缓冲区末尾，说明当前缓冲区数据已读完，跳出循环（等待新数据）
-        if (lineEnd == buff.BeginWriteConst()) {
-            break; //读完了
+    }
+    consumed_ = pos_;
+    LOG_DEBUG("[%s], [%s], [%s]", method_.c_str(), path_.c_str(), version_.c_str());
+    return PARSE_OK;
+}
+
+//请求头都到齐后再确定请求体长度和连接方式，并决定请求体的接收方式（下一个状态）
+bool HttpRequest::FinishHeaders_() {
+    contentLen_ = 0;
+    if (hot_[HDR_CONTENT_LENGTH] >= 0) {
+        const Field& f = fields_[hot_[HDR_CONTENT_LENGTH]];
+        const char* p = base_ + f.value;
+        if (f.valueLen == 0 || f.valueLen > 18) {
+            LOG_ERROR("Bad Content-Length");
+            return false;
+        }
+        for (uint32_t i = 0; i < f.valueLen; i++) {
+            if (!isdigit(static_cast<unsigned char>(p[i]))) {
+                LOG_ERROR("Bad Content-Length");
+                return false;
+            }
+            contentLen_ = contentLen_ * 10 + (p[i] - '0');
         }
-        buff.RetrieveUntil(lineEnd + 2);
+        if (contentLen_ > maxBodySize) {
+            LOG_ERROR("Request body too large: %zu", contentLen_);
+            return Fail_(413);
+        }
+    }
+    bool chunked = false;
+    if (hot_[HDR_TRANSFER_ENCODING] >= 0) {
+        //只支持chunked；同时带Content-Length的请求可能被用来走私请求，直接拒绝
+        const Field& f = fields_[hot_[HDR_TRANSFER_ENCODING]];
+        if (f.valueLen != 7 || !EqualNoCase_(base_ + f.value, "chunked", 7)) {
+            LOG_ERROR("Unsupported Transfer-Encoding");
+            return false;
+        }
+        if (hot_[HDR_CONTENT_LENGTH] >= 0) {
+            LOG_ERROR("Both Transfer-Encoding and Content-Length");
+            return false;
+        }
+        chunked = true;
+    }
+    string conn = Header(HDR_CONNECTION);
+    transform(conn.begin(), conn.end(), conn.begin(), ::tolower);
+    if (version_ == "1.1") {
+        keepAlive_ = conn.find("close") == string::npos;
+    } else {
+        keepAlive_ = conn.find("keep-alive") != string::npos;
+    }
+    bodyLeft_ = contentLen_;
+    if (chunked) {
+        state_ = CHUNK_SIZE;
+    } else if (contentLen_ > spoolSize) {
+        state_ = BODY_STREAM;
+        return OpenSpool_();
+    } else {
+        state_ = contentLen_ > 0 ? BODY : FINISH;
+    }
+    return true;
+}
+
+bool HttpRequest::Fail_(int code) {
+    error_ = code;
+    return false;
+}
+
+//请求头复制到head_，base_改指副本；之后读缓冲区中只剩请求体（及后面的请求），请求体可以边解析边取走
+void HttpRequest::DetachHead_(Buffer& buff) {
+    head_.assign(base_, pos_);
+    buff.Retrieve(pos_);
+    base_ = head_.data();
+    pos_ = scan_ = 0;
+}
+
+//流式接收请求体：数据取走后就不再留在读缓冲区，一个连接占用的内存与请求体大小无关
+//pos_在这里记录trailer的总长度
+HttpRequest::PARSE_RESULT HttpRequest::ParseStream_(Buffer& buff) {
+    while (state_ != FINISH) {
+        const size_t size = buff.ReadableBytes();
+        const char* begin = buff.Peek();
+        const char* end = begin + size;
+        if (state_ == BODY_STREAM || state_ == CHUNK_DATA) {
+            size_t n = min(size, bodyLeft_);
+            if (n > 0) {
+                if (!AppendBody_(begin, n)) {
+                    return PARSE_ERROR;
+                }
+                buff.Retrieve(n);
+                bodyLeft_ -= n;
+            }
+            if (bodyLeft_ > 0) {
+                return PARSE_AGAIN;
+            }
+            state_ = state_ == BODY_STREAM ? FINISH : CHUNK_END;
+            continue;
+        }
+        //分块的各行：块大小行、块数据后的CRLF、trailer
+        const char* lineEnd = CharScan::FindCrlf(begin + scan_, end);
+        if (lineEnd == end) {
+            if (size > (state_ == TRAILER ? MAX_HEAD : MAX_CHUNK_LINE)) {
+                LOG_ERROR("Chunk line too long");
+                return PARSE_ERROR;
+            }
+            scan_ = size > 0 ? size - 1 : 0; //最后一个字节可能是'\r'
+            return PARSE_AGAIN;
+        }
+        scan_ = 0;
+        bool ok = true;
+        if (state_ == CHUNK_SIZE) {
+            ok = ParseChunkSize_(begin, lineEnd);
+        } else if (state_ == CHUNK_END) {
+            ok = lineEnd == begin; //块数据后面必须紧跟CRLF
+            state_ = CHUNK_SIZE;
+            if (!ok) LOG_ERROR("Chunk data not followed by CRLF");
+        } else if (lineEnd == begin) {
+            state_ = FINISH; //trailer结束；trailer字段不使用，只限制长度
+        } else {
+            pos_ += lineEnd + 2 - begin;
+            ok = pos_ <= MAX_HEAD;
+            if (!ok) LOG_ERROR("Trailer too large");
+        }
+        buff.Retrieve(lineEnd + 2 - begin);
+        if (!ok) {
+            return PARSE_ERROR;
+        }
+    }
+    consumed_ = 0; //请求的字节都已取走
+    if (bodyFd_ >= 0) {
+        lseek(bodyFd_, 0, SEEK_SET); //交给处理者从头读取
+        LOG_DEBUG("Body spooled: %zu bytes", bodySize_);
+    } else {
+        ParsePost_();
     }
-    //c_str()是将string转换为C风格字符串（const char*）
     LOG_DEBUG("[%s], [%s], [%s]", method_.c_str(), path_.c_str(), version_.c_str());
+    return PARSE_OK;
+}
+
+//块大小行：十六进制长度，后面可以有;开头的扩展（忽略）
+bool HttpRequest::ParseChunkSize_(const char* begin, const char* end) {
+    const char* p = begin;
+    size_t size = 0;
+    for (; p < end && isxdigit(static_cast<unsigned char>(*p)); p++) {
+        if (p - begin >= 15) {
+            LOG_ERROR("Bad chunk size");
+            return false;
+        }
+        size = size * 16 + ConverHex(*p);
+    }
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    if (p == begin || (p < end && *p != ';') || CharScan::FindCtl(p, end) != end) {
+        LOG_ERROR("Bad chunk size");
+        return false;
+    }
+    if (size > maxBodySize - bodySize_) {
+        LOG_ERROR("Request body too large: %zu", bodySize_ + size);
+        return Fail_(413);
+    }
+    bodyLeft_ = size;
+    state_ = size > 0 ? CHUNK_DATA : TRAILER; //长度为0的块是最后一块
+    return true;
+}
+
+static bool WriteAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+//请求体不超过spoolSize时留在内存中（表单），超过后转入临时文件
+bool HttpRequest::AppendBody_(const char* data, size_t len) {
+    if (bodyFd_ < 0 && body_.size() + len > spoolSize) {
+        if (!OpenSpool_()) {
+            return false;
+        }
+        bool ok = WriteAll(bodyFd_, body_.data(), body_.size());
+        string().swap(body_);
+        if (!ok) {
+            LOG_ERROR("Spool request body failed, errno:%d", errno);
+            return Fail_(500);
+        }
+    }
+    bodySize_ += len;
+    if (bodyFd_ < 0) {
+        body_.append(data, len);
+    } else if (!WriteAll(bodyFd_, data, len)) {
+        LOG_ERROR("Spool request body failed, errno:%d", errno);
+        return Fail_(500);
+    }
+    return true;
+}
+
+//匿名临时文件（O_TMPFILE），文件系统不支持时创建后立即删除，进程退出或请求结束时自动回收
+bool HttpRequest::OpenSpool_() {
+    const char* dir = getenv("TMPDIR");
+    if (!dir || !*dir) {
+        dir = "/tmp";
+    }
+    bodyFd_ = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (bodyFd_ < 0) {
+        string path = string(dir) + "/webserver-body-XXXXXX";
+        bodyFd_ = mkostemp(&path[0], O_CLOEXEC);
+        if (bodyFd_ >= 0) {
+            unlink(path.c_str());
+        }
+    }
+    if (bodyFd_ < 0) {
+        LOG_ERROR("Open spool file in %s failed, errno:%d", dir, errno);
+        return Fail_(500);
+    }
     return true;
 }
 
@@ -97,39 +384,111 @@ void HttpRequest::ParsePath_() {
     }
 }
 
-bool HttpRequest::ParseRequestLine_(const string& line) {
-    //^匹配字符串的开始位置，在[]中则表示“非”，表示不接受方括号表达式中的字符
-    regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    smatch subMatch; //用于存储正则匹配到的结果（捕获组）
-    if (regex_match(line, subMatch, patten)) {
-        method_ = subMatch[1];
-        path_ = subMatch[2];
-        version_ = subMatch[3];
-        state_ = HEADERS;
-        return true;
-    }
-    LOG_ERROR("RequestLine Error");
-    return false;
+//请求行：方法 SP 请求目标 SP HTTP/主版本.次版本，方法为token，目标以'/'开头，只接受HTTP/1.x
+bool HttpRequest::ParseRequestLine_(const char* begin, const char* end) {
+    const char* p = begin;
+    while (p < end && IsToken(*p)) p++;
+    if (p == begin || p == end || *p != ' ') {
+        LOG_ERROR("RequestLine Error: bad method");
+        return false;
+    }
+    method_.assign(begin, p);
+
+    const char* target = ++p;
+    while (p < end && IsTargetChar(*p)) p++;
+    if (p == target || p == end || *p != ' ' || *target != '/') {
+        LOG_ERROR("RequestLine Error: bad target");
+        return false;
+    }
+    path_.assign(target, p);
+
+    p++;
+    if (end - p != 8 || memcmp(p, "HTTP/1.", 7) != 0 || !isdigit(static_cast<unsigned char>(p[7]))) {
+        LOG_ERROR("RequestLine Error: bad version");
+        return false;
+    }
+    version_.assign(p + 5, 3);
+    state_ = HEADERS;
+    return true;
 }
 
-void HttpRequest::ParseHeader_(const string& line) {
-    //.表示任意字符
-    regex patten("^([^:]*): ?(.*)$");
-    smatch subMatch;
-    if(regex_match(line, subMatch, patten)) {
-        header_[subMatch[1]] = subMatch[2];
+//请求头：字段名 ":" OWS 字段值 OWS；字段名与冒号之间不允许空白，不接受折行（obs-fold）
+bool HttpRequest::ParseHeader_(const char* begin, const char* end) {
+    const char* p = begin;
+    while (p < end && IsToken(*p)) p++;
+    if (p == begin || p == end || *p != ':') {
+        LOG_ERROR("Header Error: bad field name");
+        return false;
     }
-    else {
-        state_ = BODY;  // 状态转换为下一个状态
+    const char* value = p + 1;
+    while (value < end && (*value == ' ' || *value == '\t')) value++;
+    const char* valueEnd = end;
+    while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t')) valueEnd--;
+    //字段值：HTAB、SP、可见字符和obs-text（>=0x80），不允许其他控制字符
+    if (CharScan::FindCtl(value, valueEnd) != valueEnd) {
+        LOG_ERROR("Header Error: bad field value");
+        return false;
+    }
+    if (fields_.size() >= MAX_FIELDS) {
+        LOG_ERROR("Header Error: too many fields");
+        return false;
+    }
+
+    Field f;
+    f.name = static_cast<uint32_t>(begin - base_);
+    f.nameLen = static_cast<uint32_t>(p - begin);
+    f.value = static_cast<uint32_t>(value - base_);
+    f.valueLen = static_cast<uint32_t>(valueEnd - value);
+    int hot = HotHeader_(begin, f.nameLen);
+    if (hot >= 0) {
+        //重复的Host/Content-Length/Transfer-Encoding可能被用来走私请求，值不同时拒绝
+        if (hot_[hot] >= 0 && (hot == HDR_HOST || hot == HDR_CONTENT_LENGTH || hot == HDR_TRANSFER_ENCODING)) {
+            const Field& prev = fields_[hot_[hot]];
+            if (prev.valueLen != f.valueLen || memcmp(base_ + prev.value, value, f.valueLen) != 0) {
+                LOG_ERROR("Header Error: conflicting duplicate field");
+                return false;
+            }
+        }
+        hot_[hot] = static_cast<int>(fields_.size());
     }
+    fields_.push_back(f);
+    return true;
 }
 
 //请求体是请求中携带的实际数据，通常在POST请求中使用
-void HttpRequest::ParseBody_(const string& line) {
-    body_ = line;
+void HttpRequest::ParseBody_(const char* begin, size_t len) {
+    body_.assign(begin, len);
+    bodySize_ = len;
     ParsePost_();
-    state_ = FINISH;    // 状态转换为下一个状态
-    LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());
+    LOG_DEBUG("Body:%s, len:%d", body_.c_str(), body_.size());
+}
+
+//不区分大小写比较，b为小写
+bool HttpRequest::EqualNoCase_(const char* a, const char* b, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (tolower(static_cast<unsigned char>(a[i])) != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//先按长度分派，每个长度最多比较一两个名字
+int HttpRequest::HotHeader_(const char* name, size_t len) {
+    switch (len) {
+        case 4:  return EqualNoCase_(name, "host", 4) ? HDR_HOST : -1;
+        case 5:  return EqualNoCase_(name, "range", 5) ? HDR_RANGE : -1;
+        case 8:  return EqualNoCase_(name, "if-range", 8) ? HDR_IF_RANGE : -1;
+        case 10: return EqualNoCase_(name, "connection", 10) ? HDR_CONNECTION : -1;
+        case 12: return EqualNoCase_(name, "content-type", 12) ? HDR_CONTENT_TYPE : -1;
+        case 13: return EqualNoCase_(name, "if-none-match", 13) ? HDR_IF_NONE_MATCH : -1;
+        case 14: return EqualNoCase_(name, "content-length", 14) ? HDR_CONTENT_LENGTH : -1;
+        case 15: return EqualNoCase_(name, "accept-encoding", 15) ? HDR_ACCEPT_ENCODING : -1;
+        case 17:
+            if (EqualNoCase_(name, "if-modified-since", 17)) return HDR_IF_MODIFIED_SINCE;
+            return EqualNoCase_(name, "transfer-encoding", 17) ? HDR_TRANSFER_ENCODING : -1;
+        default: return -1;
+    }
 }
 
 // 16进制转化为10进制
@@ -142,7 +501,11 @@ int HttpRequest::ConverHex(char ch) {
 
 void HttpRequest::ParsePost_() {
     //POST请求且为表单数据
-    if (method_ == "POST" && header_["Content-Type"] == "application/x-www-form-urlencoded") {
+    static const char FORM[] = "application/x-www-form-urlencoded";
+    const size_t formLen = sizeof(FORM) - 1;
+    string type = Header(HDR_CONTENT_TYPE); //可能带有 ; charset=... 参数
+    if (method_ == "POST" && type.size() >= formLen && EqualNoCase_(type.data(), FORM, formLen)
+        && (type.size() == formLen || type[formLen] == ';' || type[formLen] == ' ')) {
         ParseFormUrlencoded_();
         if (DEFAULT_HTML_TAG.count(path_)) {
             int tag = DEFAULT_HTML_TAG.find(path_)->second;
@@ -169,44 +532,60 @@ void HttpRequest::ParsePost_() {
 void HttpRequest::ParseFormUrlencoded_() {
     if (body_.size() == 0) return;
 
-    string key, value;
-    int num  = 0;
-    int n = body_.size();
-    int i = 0, j = 0;
-
-    for (; i <n; i++) {
-        char ch = body_[i];
-        switch (ch) {
+    //在body_上原地解码：r读、w写，解码后的内容只会比原文短；两个分隔符之间的普通字符整段搬移
+    string key;
+    bool haveKey = false;
+    char* w = &body_[0];
+    char* seg = w; //当前键或值（解码后）的起点
+    const char* r = w;
+    const char* end = r + body_.size();
+    while (true) {
+        const char* d = CharScan::FindFormDelim(r, end);
+        if (w != r) {
+            memmove(w, r, d - r);
+        }
+        w += d - r;
+        r = d;
+        if (r == end) {
+            break;
+        }
+        switch (*r) {
             case '=': //遇到“=”：前面的部分是键（key）
-                key = body_.substr(j, i-j);
-                j = i + 1;
+                key.assign(seg, w);
+                haveKey = true;
+                seg = w;
+                r++;
                 break;
             case '+': //遇到“+”：URL编码中“+”代表空格，替换为空格
-                body_[i] = ' ';
+                *w++ = ' ';
+                r++;
                 break;
-            case '%': //遇到“%”：URL编码的特殊字符（如%20代表空格）
-                //解析%后面的两个十六进制字符（如%20中，20是十六进制）
-                num = ConverHex(body_[i + 1]) * 16 + ConverHex(body_[i + 2]);
-                // body_[i + 2] = num % 10 + '0';
-                // body_[i + 1] = num / 10 + '0';
-                body_[i] = static_cast<char>(num);
-                i += 2;
+            case '%': //遇到“%”：URL编码的特殊字符（如%20代表空格），后面不是两个十六进制字符时按原样保留
+                if (end - r >= 3 && isxdigit(static_cast<unsigned char>(r[1]))
+                    && isxdigit(static_cast<unsigned char>(r[2]))) {
+                    *w++ = static_cast<char>(ConverHex(r[1]) * 16 + ConverHex(r[2]));
+                    r += 3;
+                } else {
+                    *w++ = *r++;
+                }
                 break;
             case '&': //遇到“&”：前面的部分是值（value），且一组键值对结束
-                value = body_.substr(j, i - j);
-                j = i + 1;
-                post_[key] = value; //将键值对存入post_哈希表
-                LOG_DEBUG("%s = %s", key.c_str(), value.c_str());
+                if (haveKey) {
+                    post_[key] = string(seg, w); //将键值对存入post_哈希表
+                    LOG_DEBUG("%s = %s", key.c_str(), post_[key].c_str());
+                }
+                haveKey = false;
+                seg = w;
+                r++;
                 break;
             default:
                 break;
         }
     }
-    assert(j <= i);
-    if (post_.count(key) == 0 && j < i) {
-        value = body_.substr(j, i - j);
-        post_[key] = value;
+    if (haveKey) {
+        post_[key] = string(seg, w);
     }
+    body_.resize(w - &body_[0]);
 }
 
 bool HttpRequest::UserVerify(const string& name, const string& pwd, bool isLogin) {
@@ -307,4 +686,21 @@ string HttpRequest::GetPost(const char* key) const {
         return post_.find(key)->second;
     }
     return "";
-}
\ No newline at end of file
+}
+
+string HttpRequest::GetHeader(const std::string& key) const {
+    for(const Field& f : fields_) {
+        if(f.nameLen == key.size() && strncasecmp(base_ + f.name, key.data(), key.size()) == 0) {
+            return string(base_ + f.value, f.valueLen);
+        }
+    }
+    return "";
+}
+
+string HttpRequest::Header(HEADER h) const {
+    if(hot_[h] < 0) {
+        return "";
+    }
+    const Field& f = fields_[hot_[h]];
+    return string(base_ + f.value, f.valueLen);
+}
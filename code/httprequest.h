@@ -3,34 +3,92 @@
 
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include <string>
-#include <regex> //正则表达式
 #include <errno.h>
+#include <stdint.h>
 #include <mysql/mysql.h>
 
 #include "buffer.h"
+#include "charscan.h"
 #include "log.h"
 #include "sqlconnpool.h"
 
+/*
+HTTP/1.1请求解析：手写的状态机直接在读缓冲区上扫描，不构造正则、不按行拷贝。
+- 请求头结束、行结束、字段值中的控制字符和表单分隔符都用CharScan的SIMD实现查找；
+- 请求行和请求头原地解析，请求头只记录名字和值在缓冲区中的偏移/长度；
+- 常用请求头（Connection、Content-Length、Host等）解析时按名字不区分大小写识别，记入固定的槽位，
+  取值时不用查找；
+- 方法、请求目标、版本、字段名和字段值按RFC 7230严格校验，不合法的请求直接判为400。
+- 请求头先用CharScan::FindHeadEnd整体查找结束的空行，到齐之后才按行切分解析；请求分几次到达时，
+  查找从上次扫描到的位置继续，不论请求被拆成多少段，解析的总工作量都与字节数成正比；数据不够时返回PARSE_AGAIN。
+- 请求体按Content-Length读取，或按Transfer-Encoding: chunked解码，总长超过maxBodySize时判为413。
+  不超过spoolSize的定长请求体留在读缓冲区中整体解析；更大的请求体和所有分块请求体以流的方式处理：
+  请求头复制出读缓冲区，请求体边到达边取走，超过spoolSize的部分写入临时文件（BodyFd()），
+  定长请求体剩下的字节由HttpConn用splice从socket直接搬进文件，不经过读缓冲区。
+请求头的偏移相对于请求在读缓冲区中的起点，解析完成前调用方不能取走读缓冲区中的数据，
+完成后只在HttpConn取走本请求的字节（Consumed()）之前有效。
+*/
 class HttpRequest {
 public:
     //请求状态
     enum PARSE_STATE {
         REQUEST_LINE, //正在解析 请求行
         HEADERS, //正在解析 请求头
-        BODY, //正在解析 请求体
+        BODY, //正在解析 请求体（整个在读缓冲区中）
+        BODY_STREAM, //定长请求体，边到达边写入临时文件
+        CHUNK_SIZE, //分块请求体：块大小行
+        CHUNK_DATA, //分块请求体：块数据
+        CHUNK_END, //分块请求体：块数据后的CRLF
+        TRAILER, //分块请求体：结尾的trailer字段，直到空行
         FINISH, //解析完成
     };
 
+    //一次解析调用的结果
+    enum PARSE_RESULT {
+        PARSE_OK, //请求完整，可以生成响应
+        PARSE_AGAIN, //数据还不完整，读入更多数据后再次调用（保留已解析的部分）
+        PARSE_ERROR, //请求不合法
+    };
+
+    //解析时识别出的常用请求头
+    enum HEADER {
+        HDR_CONNECTION = 0,
+        HDR_CONTENT_LENGTH,
+        HDR_CONTENT_TYPE,
+        HDR_HOST,
+        HDR_ACCEPT_ENCODING,
+        HDR_RANGE,
+        HDR_IF_RANGE,
+        HDR_IF_NONE_MATCH,
+        HDR_IF_MODIFIED_SINCE,
+        HDR_TRANSFER_ENCODING,
+        HDR_COUNT,
+    };
+
     HttpRequest() {
+        bodyFd_ = -1;
         Init();
     }
-    ~HttpRequest() = default;
+    ~HttpRequest();
 
     void Init();
     //核心解析函数
-    //从缓冲区 buff 中读取 HTTP 请求数据，按状态逐步解析
-    bool parse(Buffer& buff); 
+    //从缓冲区 buff 中解析一个 HTTP 请求，不取走数据（由调用方按Consumed()取走），流式接收的请求头和请求体除外
+    //上一个请求已完成时自动开始解析下一个
+    PARSE_RESULT parse(Buffer& buff); 
+    size_t Consumed() const { return consumed_; } //本请求留在读缓冲区中的字节数（流式处理的请求体已经取走）
+    int ErrorCode() const { return error_; } //PARSE_ERROR时应答的状态码（400、413或500）
+
+    //请求体写入了临时文件时（超过spoolSize）的文件描述符，解析完成后读写位置在文件开头；否则为-1
+    int BodyFd() const { return bodyFd_; }
+    size_t BodySize() const { return bodySize_; } //已收到的请求体字节数（分块请求体为解码后的长度）
+    const std::string& Body() const { return body_; } //请求体留在内存中时（BodyFd()为-1）的内容，表单请求为解码后的
+    bool Streaming() const { return state_ > BODY && state_ < FINISH; } //请求头已解析完，正在流式接收请求体
+    //定长请求体写入临时文件时，读缓冲区之外还差的字节数：调用方可以直接从socket搬进BodyFd()，再调用BodySpliced
+    size_t SpliceLeft() const { return state_ == BODY_STREAM ? bodyLeft_ : 0; }
+    void BodySpliced(size_t n) { bodyLeft_ -= n; bodySize_ += n; }
 
     std::string path() const; //获取请求路径，不可修改（如 /login.html）
     std::string& path(); //获取请求路径的引用，可修改
@@ -38,24 +96,63 @@ public:
     std::string version() const; //获取HTTP版本
     std::string GetPost(const std::string& key) const; //从POST表单数据中获取指定key的值
     std::string GetPost(const char* key) const;
+    std::string GetHeader(const std::string& key) const; //获取请求头字段的值（名字不区分大小写），不存在时返回空串
+    std::string Header(HEADER h) const; //常用请求头的值，不存在时返回空串
+    bool HasHeader(HEADER h) const { return hot_[h] >= 0; }
 
     bool IsKeepAlive() const; //判断当前请求是否需要“长连接”
 
+    static size_t maxBodySize; //请求体的上限（分块请求体按解码后的长度）
+    static size_t spoolSize; //请求体超过这个长度时写入临时文件
+
 private:
-    bool ParseRequestLine_(const std::string& line); //处理请求行
-    void ParseHeader_(const std::string& line); //处理请求头
-    void ParseBody_(const std::string& line); //处理请求体
+    //字段在请求中的位置（相对base_的偏移）
+    struct Field {
+        uint32_t name, nameLen;
+        uint32_t value, valueLen;
+    };
+
+    bool ParseRequestLine_(const char* begin, const char* end); //处理请求行
+    bool ParseHeader_(const char* begin, const char* end); //处理一行请求头
+    bool FinishHeaders_(); //请求头都到齐后确定请求体长度和连接方式
+    void ParseBody_(const char* begin, size_t len); //处理请求体
+    PARSE_RESULT ParseStream_(Buffer& buff); //流式接收请求体（定长写文件/分块解码），边解析边取走
+    bool ParseChunkSize_(const char* begin, const char* end);
+    void DetachHead_(Buffer& buff); //把请求头复制出读缓冲区，之后可以取走请求体的字节
+    bool AppendBody_(const char* data, size_t len); //保存一段请求体：内存中或临时文件
+    bool OpenSpool_();
+    bool Fail_(int code); //记录应答的状态码，返回false
 
     void ParsePath_(); //处理请求路径
     void ParsePost_(); //处理Post事件
     void ParseFormUrlencoded_(); //从url解析编码
 
+    static int HotHeader_(const char* name, size_t len); //常用请求头的槽位，其他返回-1
+    static bool EqualNoCase_(const char* a, const char* b, size_t len);
+
     //用户验证
     static bool UserVerify(const std::string& name, const std::string& pwd, bool isLogin);
 
+    static const size_t MAX_HEAD = 64 * 1024; //请求行+请求头的上限
+    static const size_t MAX_FIELDS = 100; //请求头个数上限
+    static const size_t MAX_CHUNK_LINE = 1024; //块大小行（含扩展）的上限
+
     PARSE_STATE state_; //当前请求的解析状态
     std::string method_, path_, version_, body_;
-    std::unordered_map<std::string, std::string> header_; //请求头，由头部字段名和值组成
+    const char* base_; //请求在读缓冲区中的起点（每次解析时重新获取，读入数据后缓冲区可能合并过），流式接收请求体时指向head_
+    size_t pos_; //下一个待解析元素（行或请求体）相对起点的偏移
+    size_t scan_; //查找请求头结束（流式请求体中为行结束）时已经扫描过的位置，下次从这里继续
+    size_t headEnd_; //请求头结束（空行之后）相对起点的偏移，还没到齐时为0
+    size_t contentLen_; //请求体长度
+    size_t bodyLeft_; //定长请求体/当前块还差的字节数
+    size_t bodySize_;
+    int bodyFd_; //请求体的临时文件
+    int error_;
+    std::string head_; //流式接收请求体时请求头的副本（base_指向这里）
+    std::vector<Field> fields_; //全部请求头，按出现顺序
+    int hot_[HDR_COUNT]; //常用请求头在fields_中的下标，没有为-1
+    bool keepAlive_;
+    size_t consumed_;
     std::unordered_map<std::string, std::string> post_;
 
     static const std::unordered_set<std::string> DEFAULT_HTML;
@@ -63,4 +160,4 @@ private:
     static int ConverHex(char ch);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,85 +1,166 @@
 #include "httpresponse.h"
+#include <vector>
+#include <algorithm>
+#include <time.h>
+#include <stdlib.h>
 
 using namespace std;
 
-const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = {
-    { ".html",  "text/html" },
-    { ".xml",   "text/xml" },
-    { ".xhtml", "application/xhtml+xml" },
-    { ".txt",   "text/plain" },
-    { ".rtf",   "application/rtf" },
-    { ".pdf",   "application/pdf" },
-    { ".word",  "application/nsword" },
-    { ".png",   "image/png" },
-    { ".gif",   "image/gif" },
-    { ".jpg",   "image/jpeg" },
-    { ".jpeg",  "image/jpeg" },
-    { ".au",    "audio/basic" },
-    { ".mpeg",  "video/mpeg" },
-    { ".mpg",   "video/mpeg" },
-    { ".avi",   "video/x-msvideo" },
-    { ".gz",    "application/x-gzip" },
-    { ".tar",   "application/x-tar" },
-    { ".css",   "text/css"},
-    { ".js",    "text/javascript"},
-};
-
 const unordered_map<int, string> HttpResponse::CODE_STATUS = {
     { 200, "OK" },
+    { 206, "Partial Content" },
+    { 304, "Not Modified" },
     { 400, "Bad Request" },
     { 403, "Forbidden" },
     { 404, "Not Found" },
+    { 413, "Payload Too Large" },
+    { 416, "Range Not Satisfiable" },
+    { 500, "Internal Server Error" },
 };
 
 const unordered_map<int, string> HttpResponse::CODE_PATH = {
     { 400, "/400.html" },
     { 403, "/403.html" },
     { 404, "/404.html" },
+    { 413, "/413.html" },
+    { 500, "/500.html" },
 };
 
+//长连接/短连接的Connection头，响应头中唯一随请求变化的部分
+static const char KEEP_ALIVE_LINES[] = "Connection: keep-alive\r\nKeep-Alive: max=6, timeout=120\r\n";
+static const char CLOSE_LINE[] = "Connection: close\r\n";
+
+//每个状态码的字节块只在第一次使用时生成一次
+const HttpResponse::StatusBlock& HttpResponse::Status_(int code) {
+    static const vector<StatusBlock> blocks = [] {
+        vector<StatusBlock> v;
+        for (const auto& kv : CODE_STATUS) {
+            StatusBlock block;
+            block.code = kv.first;
+            block.line = "HTTP/1.1 " + to_string(kv.first) + " " + kv.second + "\r\n";
+            auto page = CODE_PATH.find(kv.first);
+            if (page != CODE_PATH.end()) {
+                block.page = page->second;
+                block.fallback = ErrorBlock_(kv.first, "File NotFound!");
+            }
+            v.push_back(block);
+        }
+        return v;
+    }();
+    const StatusBlock* bad = nullptr;
+    for (const StatusBlock& block : blocks) {
+        if (block.code == code) return block;
+        if (block.code == 400) bad = &block;
+    }
+    return *bad; //无效的状态码按400处理
+}
+
 HttpResponse::HttpResponse() {
     code_ = 1;
+    fill(acceptEnc_, acceptEnc_ + FileEntry::ENC_COUNT, false);
     path_ = srcDir_ = "";
     isKeepAlive_ = false;
-    mmFile_ = nullptr;
-    mmFileStat_ = { 0 };
 }
 
 HttpResponse::~HttpResponse() {
-    UnmapFile();
+    ReleaseFile();
 }
 
 void HttpResponse::Init(const string& srcDir, string& path,
                         bool isKeepAlive, int code) {
     assert(srcDir != "");
-    if (mmFile_) UnmapFile();
+    ReleaseFile();
     code_ = code;
     isKeepAlive_ = isKeepAlive;
     path_ = path;
     srcDir_ = srcDir;
-    mmFile_ = nullptr; 
-    mmFileStat_ = { 0 };
+    ifNoneMatch_.clear();
+    ifModifiedSince_.clear();
+    range_.clear();
+    ifRange_.clear();
+    ranges_.clear();
+    fill(acceptEnc_, acceptEnc_ + FileEntry::ENC_COUNT, false);
+}
+
+//Accept-Encoding: gzip, deflate, br;q=0.8, *;q=0（RFC 7231），q=0表示不接受，*匹配未列出的编码
+void HttpResponse::SetEncoding(const string& acceptEncoding) {
+    int listed[FileEntry::ENC_COUNT] = {}; //-1不接受，0未列出，1接受
+    int star = 0;
+    size_t pos = 0;
+    while (pos < acceptEncoding.size()) {
+        size_t end = acceptEncoding.find(',', pos);
+        if (end == string::npos) end = acceptEncoding.size();
+        string item = acceptEncoding.substr(pos, end - pos);
+        pos = end + 1;
+        size_t semi = item.find(';');
+        string name = item.substr(0, semi);
+        name.erase(0, name.find_first_not_of(' '));
+        name.erase(name.find_last_not_of(' ') + 1);
+        transform(name.begin(), name.end(), name.begin(), ::tolower);
+        int accept = 1;
+        if (semi != string::npos) {
+            size_t q = item.find("q=", semi);
+            if (q != string::npos && strtod(item.c_str() + q + 2, nullptr) <= 0) {
+                accept = -1;
+            }
+        }
+        if (name == "*") {
+            star = accept;
+        }
+        for (int i = 0; i < FileEntry::ENC_COUNT; i++) {
+            if (name == FileCache::EncodingName(i) || (i == FileEntry::ENC_GZIP && name == "x-gzip")) {
+                listed[i] = accept;
+            }
+        }
+    }
+    for (int i = 0; i < FileEntry::ENC_COUNT; i++) {
+        acceptEnc_[i] = listed[i] > 0 || (listed[i] == 0 && star > 0);
+    }
+}
+
+void HttpResponse::SetConditional(const string& ifNoneMatch, const string& ifModifiedSince) {
+    ifNoneMatch_ = ifNoneMatch;
+    ifModifiedSince_ = ifModifiedSince;
+}
+
+void HttpResponse::SetRange(const string& range, const string& ifRange) {
+    range_ = range;
+    ifRange_ = ifRange;
 }
 
 void HttpResponse::MakeResponse(Buffer& buff) {
-    string fullpath = srcDir_ + path_;
-    //第一个参数为要查询的文件
-    //第二个参数为struct stat 结构体指针，用于存储查询到的文件状态信息
-    //成功返回0，并将文件信息写入 buf 结构体，失败返回-1
+    //从文件缓存取文件：命中时stat结果、映射都已就绪，不需要任何系统调用
+    //请求本身不合法（400、413）或接收时出错（500）时不查找文件
+    bool failed = code_ >= 400;
+    file_ = failed ? nullptr : FileCache::Instance()->Get(srcDir_ + path_);
     //S_ISDIR判断是否是目录
-    if (stat(fullpath.c_str(), &mmFileStat_) < 0 
-                    || S_ISDIR(mmFileStat_.st_mode)) {
-        //情况1：文件不存在（stat 调用失败），或请求的是目录（不是文件）
+    if (failed) {
+        //情况0：请求解析/接收失败，不论路径是否存在都回复错误
+    } else if (!file_ || S_ISDIR(file_->st.st_mode)) {
+        //情况1：文件不存在，或请求的是目录（不是文件）
         code_ = 404;
     //&位判断运算
     //S_IROTH表示 “其他用户是否有读权限”
-    } else if (!(mmFileStat_.st_mode & S_IROTH)) {
+    } else if (!(file_->st.st_mode & S_IROTH)) {
         //情况2：文件存在，但没有“其他用户可读”权限（S_IROTH 是读权限标志）
         code_ = 403;
     } else if (code_ == -1) {
         //情况3：文件存在且有权限，且之前未设置状态码
         code_ = 200;
     }
+    if (code_ == 200 && range_.empty()) {
+        //之后的校验值都针对选中的版本；带Range时只发原文件的区间：
+        //多段响应的各段无法标注Content-Encoding，客户端也按原文件的长度续传
+        SelectVariant_();
+    }
+    if (code_ == 200 && NotModified_()) {
+        //情况4：客户端缓存仍然有效，只回复校验值，不发送文件内容
+        code_ = 304;
+    }
+    if (code_ == 200 && !range_.empty() && S_ISREG(file_->st.st_mode)) {
+        //情况5：只请求文件的一部分（206），或请求的区间都不在文件内（416）
+        ParseRange_();
+    }
     ErrorHtml_();
     AddStateLine_(buff);
     AddHeader_(buff);
@@ -87,123 +168,225 @@ void HttpResponse::MakeResponse(Buffer& buff) {
 }
 
 char* HttpResponse::File() {
-    return mmFile_;
+    return file_ ? file_->data : nullptr;
 }
 
 size_t HttpResponse::FileLen() const{
-    return mmFileStat_.st_size;
+    return file_ ? file_->st.st_size : 0;
 }
 
-void HttpResponse::ErrorHtml_() {
-    if (CODE_PATH.count(code_) == 1) {
-        path_ = CODE_PATH.find(code_)->second;
-        string fullpath = srcDir_ + path_;
-        stat(fullpath.c_str(), &mmFileStat_);
+//If-None-Match优先；没有时才比较If-Modified-Since（RFC 7232）
+bool HttpResponse::NotModified_() const {
+    if (!ifNoneMatch_.empty()) {
+        //逗号分隔的ETag列表，*匹配任何版本；If-None-Match按弱比较，忽略W/前缀
+        size_t pos = 0;
+        while (pos < ifNoneMatch_.size()) {
+            size_t end = ifNoneMatch_.find(',', pos);
+            if (end == string::npos) end = ifNoneMatch_.size();
+            size_t b = ifNoneMatch_.find_first_not_of(' ', pos);
+            size_t e = ifNoneMatch_.find_last_not_of(' ', end - 1);
+            pos = end + 1;
+            if (b == string::npos || b >= end || e < b) continue;
+            if (ifNoneMatch_.compare(b, 2, "W/") == 0) b += 2;
+            if (ifNoneMatch_.compare(b, e - b + 1, "*") == 0
+                || ifNoneMatch_.compare(b, e - b + 1, file_->etag) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+    if (!ifModifiedSince_.empty()) {
+        if (ifModifiedSince_ == file_->lastModified) {
+            return true; //浏览器通常原样带回Last-Modified
+        }
+        struct tm tmGmt = {};
+        const char* end = strptime(ifModifiedSince_.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tmGmt);
+        return end && *end == '\0' && file_->st.st_mtime <= timegm(&tmGmt);
     }
+    return false;
 }
 
-void HttpResponse::AddStateLine_(Buffer& buff) {
-    string status;
-    if(CODE_STATUS.count(code_) == 1) {
-        status = CODE_STATUS.find(code_)->second;
+//Range: bytes=0-499,1000-,-500（RFC 7233），最多MAX_RANGES段
+//If-Range与当前版本不符、格式错误或段数过多时忽略Range，发送整个文件
+void HttpResponse::ParseRange_() {
+    static const size_t MAX_RANGES = 16;
+    if (!ifRange_.empty() && ifRange_ != file_->etag && ifRange_ != file_->lastModified) {
+        return; //客户端手里的是旧版本，需要重新下载整个文件
+    }
+    if (range_.compare(0, 6, "bytes=") != 0) {
+        return;
+    }
+    const off_t size = file_->st.st_size;
+    vector<pair<off_t, off_t>> spans; //[first, last]
+    bool any = false; //是否有语法正确的段（全部落在文件外时回复416）
+    size_t pos = 6;
+    while (pos < range_.size()) {
+        size_t end = range_.find(',', pos);
+        if (end == string::npos) end = range_.size();
+        string spec = range_.substr(pos, end - pos);
+        pos = end + 1;
+        spec.erase(0, spec.find_first_not_of(' '));
+        spec.erase(spec.find_last_not_of(' ') + 1);
+        size_t dash = spec.find('-');
+        if (spec.empty() || dash == string::npos) {
+            return;
+        }
+        string a = spec.substr(0, dash), b = spec.substr(dash + 1);
+        if ((!a.empty() && a.find_first_not_of("0123456789") != string::npos)
+            || (!b.empty() && b.find_first_not_of("0123456789") != string::npos) || (a.empty() && b.empty())
+            || a.size() > 18 || b.size() > 18) {
+            return;
+        }
+        off_t first, last;
+        if (a.empty()) { //后缀区间：最后b个字节
+            off_t n = strtoll(b.c_str(), nullptr, 10);
+            first = n >= size ? 0 : size - n;
+            last = size - 1;
+            if (n == 0) { any = true; continue; }
+        } else {
+            first = strtoll(a.c_str(), nullptr, 10);
+            last = b.empty() ? size - 1 : min<off_t>(strtoll(b.c_str(), nullptr, 10), size - 1);
+            if (!b.empty() && strtoll(b.c_str(), nullptr, 10) < first) {
+                return; //last < first：整个Range无效
+            }
+        }
+        any = true;
+        if (first < size && size > 0) {
+            spans.emplace_back(first, last);
+        }
+        if (spans.size() > MAX_RANGES) {
+            return;
+        }
+    }
+    if (spans.empty()) {
+        code_ = any ? 416 : code_;
+        return;
     }
-    else {
-        //如果code_ 无效（不在映射表中），默认设为400错误
-        code_ = 400;
-        status = CODE_STATUS.find(400)->second;
+    code_ = 206;
+    if (spans.size() == 1) {
+        ranges_.push_back({ "", spans[0].first, static_cast<size_t>(spans[0].second - spans[0].first + 1) });
+        return;
     }
-    buff.Append("HTTP/1.1 " + to_string(code_) + " " + status + "\r\n");
+    //多段：multipart/byteranges，每段前面是分隔行和段头，最后是结束分隔行
+    char boundary[32];
+    snprintf(boundary, sizeof(boundary), "%016zx", hash<string>()(file_->etag));
+    boundary_ = boundary;
+    for (size_t i = 0; i < spans.size(); i++) {
+        string head = i ? "\r\n--" : "--";
+        head += boundary_;
+        head += "\r\nContent-type: " + file_->mime + "\r\nContent-Range: bytes " + to_string(spans[i].first) + "-"
+              + to_string(spans[i].second) + "/" + to_string(size) + "\r\n\r\n";
+        ranges_.push_back({ head, spans[i].first, static_cast<size_t>(spans[i].second - spans[i].first + 1) });
+    }
+    ranges_.push_back({ "\r\n--" + boundary_ + "--\r\n", 0, 0 });
+}
+
+void HttpResponse::SelectVariant_() {
+    for (int i = 0; i < FileEntry::ENC_COUNT; i++) {
+        if (acceptEnc_[i] && file_->variants[i]) {
+            file_ = file_->variants[i];
+            return;
+        }
+    }
+}
+
+void HttpResponse::MakeStreamHead(Buffer& buff, const string& contentType, bool chunked) {
+    code_ = 200;
+    AddStateLine_(buff);
+    AddHeader_(buff);
+    buff.Append("Content-type: " + contentType + "\r\n");
+    if (chunked) {
+        buff.Append("Transfer-Encoding: chunked\r\n");
+    }
+    buff.Append("Cache-Control: no-cache\r\n\r\n"); //动态内容
+}
+
+void HttpResponse::ErrorHtml_() {
+    const StatusBlock& status = Status_(code_);
+    if (!status.page.empty()) {
+        path_ = status.page;
+        file_ = FileCache::Instance()->Get(srcDir_ + path_);
+    }
+}
+
+void HttpResponse::AddStateLine_(Buffer& buff) {
+    const StatusBlock& status = Status_(code_);
+    code_ = status.code; //如果code_ 无效（不在映射表中），默认设为400错误
+    buff.Append(status.line);
 }
 
 void HttpResponse::AddHeader_(Buffer& buff) {
-    buff.Append("Connection: ");
     if(isKeepAlive_) {
-        buff.Append("keep-alive\r\n");
-        buff.Append("Keep-Alive: max=6, timeout=120\r\n");
+        buff.Append(KEEP_ALIVE_LINES, sizeof(KEEP_ALIVE_LINES) - 1);
     } else{
-        buff.Append("close\r\n");
+        buff.Append(CLOSE_LINE, sizeof(CLOSE_LINE) - 1);
     }
-    buff.Append("Content-type: " + GetFileType_() + "\r\n");
 }
 
 void HttpResponse::AddContent_(Buffer& buff) {
-    string fullpath = srcDir_ + path_;
-    //采用C风格的open打开文件，而不用ifstream
-    //因为mmap函数需要文件描述符（int 类型）
-    //O_RDONLY为fcntl.h头文件的一个宏定义，指定文件的打开模式（只读）
-    int srcFd = open(fullpath.c_str(), O_RDONLY); 
-
-    if(srcFd < 0) { //如果打开失败
-        ErrorContent(buff, "File NotFound!");
-        return; 
-    }
-
-    LOG_DEBUG("file path %s", fullpath.c_str()); //打印日志
-    //将文件映射到内存（高效读取文件内容）
-    // 参数说明：
-    // 0：让系统自动分配内存地址
-    // mmFileStat_.st_size：映射的文件大小（从之前获取的文件状态中获取）
-    // PROT_READ：内存区域权限为“只读”
-    // MAP_PRIVATE：建立私有映射（修改内存不会影响原文件）
-    // srcFd：已打开的文件描述符
-    // 0：从文件开头开始映射
-    if (mmFileStat_.st_size > 0) {
-        void* mapRet = mmap(nullptr, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-        if (mapRet == MAP_FAILED) {
-            // 映射失败，关闭文件并返回错误内容
-            close(srcFd);
-            code_ = 404;
-            ErrorContent(buff, "File NotFound!");
-            return;
+    if(code_ == 304) { //304只发校验值，没有响应体
+        buff.Append(file_->validators);
+        buff.Append("\r\n", 2);
+        file_.reset();
+        return;
+    }
+    if(code_ == 416) { //请求的区间都不在文件内：告知文件大小，没有响应体
+        buff.Append("Content-Range: bytes */" + to_string(file_->st.st_size) + "\r\nContent-length: 0\r\n\r\n");
+        file_.reset();
+        return;
+    }
+    if(code_ == 206) { //部分内容：响应头按请求的区间生成，响应体由HttpConn从文件的对应位置零拷贝发送
+        size_t total = 0;
+        for (const BodyRange& r : ranges_) total += r.head.size() + r.len;
+        if (ranges_.size() == 1) {
+            const BodyRange& r = ranges_[0];
+            buff.Append("Content-type: " + file_->mime + "\r\nContent-Range: bytes " + to_string(r.start) + "-"
+                        + to_string(r.start + r.len - 1) + "/" + to_string(file_->st.st_size) + "\r\n");
+        } else {
+            buff.Append("Content-type: multipart/byteranges; boundary=" + boundary_ + "\r\n");
         }
-        // 保存内存映射的地址
-        mmFile_ = static_cast<char*>(mapRet);
+        buff.Append("Content-length: " + to_string(total) + "\r\nAccept-Ranges: bytes\r\n");
+        buff.Append(file_->validators);
+        buff.Append("\r\n", 2);
+        return;
     }
-    // 关闭文件描述符（无论是否映射）
-    close(srcFd);
-    //添加Content-length响应头
-    buff.Append("Content-length: " + to_string(mmFileStat_.st_size) + "\r\n\r\n");
-}
-
-//释放内存映射资源
-void HttpResponse::UnmapFile() {
-    if(mmFile_) {
-        munmap(mmFile_, mmFileStat_.st_size);
-        //将指针置空避免野指针
-        mmFile_ = nullptr;
+    if(!file_ || !S_ISREG(file_->st.st_mode)) { //文件不存在（错误页面也没有）：发送预先生成的错误页面
+        file_.reset();
+        buff.Append(Status_(code_).fallback);
+        return;
     }
+    LOG_DEBUG("file path %s%s", srcDir_.c_str(), path_.c_str()); //打印日志
+    //小文件的内容在映射中，由writev和响应头一起发送；大文件由HttpConn::write用sendfile发送
+    //Content-type、Content-length在文件加载时已经生成
+    buff.Append(file_->headers);
+    buff.Append("\r\n", 2);
 }
 
-// 判断文件类型 
-string HttpResponse::GetFileType_() {
-    //查找最后一个点，用于查找后缀
-    string::size_type idx = path_.find_last_of('.');
-    if(idx == string::npos) {   
-        return "text/plain"; //没找到，默认按纯文本处理
-    }
-    string suffix = path_.substr(idx); //找到后缀后分割后缀
-    if(SUFFIX_TYPE.count(suffix) == 1) {
-        return SUFFIX_TYPE.find(suffix)->second; //从后缀表中查找对应类型返回
-    }
-    return "text/plain"; ////从后缀表中无对应类型则按纯文本处理
+//放弃对文件的引用：文件仍在缓存中时不会munmap/close，被淘汰后由最后一个持有者释放
+void HttpResponse::ReleaseFile() {
+    file_.reset();
 }
 
 //生成错误响应内容
 void HttpResponse::ErrorContent(Buffer& buff, string message) 
 {
+    buff.Append(ErrorBlock_(code_, message));
+}
+
+//错误页面的Content-type、Content-length和正文
+string HttpResponse::ErrorBlock_(int code, const string& message) {
     string body;
     string status;
     body += "<html><title>Error</title>";
     body += "<body bgcolor=\"ffffff\">";
-    if(CODE_STATUS.count(code_) == 1) {
-        status = CODE_STATUS.find(code_)->second;
+    if(CODE_STATUS.count(code) == 1) {
+        status = CODE_STATUS.find(code)->second;
     } else {
         status = "Bad Request";
     }
-    body += to_string(code_) + " : " + status  + "\n";
+    body += to_string(code) + " : " + status  + "\n";
     body += "<p>" + message + "</p>";
     body += "<hr><em>UIEWebServer</em></body></html>";
 
-    buff.Append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
-    buff.Append(body);
-}
\ No newline at end of file
+    return "Content-type: text/html\r\nContent-length: " + to_string(body.size()) + "\r\n\r\n" + body;
+}
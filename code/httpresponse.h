@@ -2,13 +2,13 @@
 #define HTTP_RESPONSE_H
 
 #include <unordered_map>
-#include <fcntl.h>
-#include <unistd.h>
+#include <vector>
+#include <memory>
 #include <sys/stat.h>
-#include <sys/mman.h>
 
 #include "buffer.h"
 #include "log.h"
+#include "filecache.h"
 
 class HttpResponse {
 public:
@@ -19,10 +19,31 @@ public:
     void Init(const std::string& srcDir_, std::string& path, 
         bool isKeepAlive = false, int code = -1);
 
+    //条件请求的校验值（If-None-Match/If-Modified-Since），文件未变化时回复304，不发送文件内容
+    void SetConditional(const std::string& ifNoneMatch, const std::string& ifModifiedSince);
+
+    //Accept-Encoding：客户端接受时发送文件的压缩版本（带Range的请求只发原文件的区间）
+    void SetEncoding(const std::string& acceptEncoding);
+
+    //Range请求头和If-Range，文件的指定区间以206回复
+    void SetRange(const std::string& range, const std::string& ifRange);
+
     void MakeResponse(Buffer& buff); //核心生成函数
+    //流式响应（200）的响应头：长度事先不知道，HTTP/1.1用分块编码，HTTP/1.0以关闭连接结束响应体
+    void MakeStreamHead(Buffer& buff, const std::string& contentType, bool chunked);
 
-    void UnmapFile(); //释放内存映射（mmFile_）
-    char* File(); //返回mmFile_指针
+    //206响应的响应体：依次发送每段的head（多段时为分隔行和段头）和文件中[start, start+len)的内容
+    struct BodyRange {
+        std::string head;
+        off_t start;
+        size_t len;
+    };
+    const std::vector<BodyRange>& Ranges() const { return ranges_; } //空表示整个文件作为响应体
+
+    void ReleaseFile(); //放弃对缓存文件的引用（响应发完或连接关闭时）
+    const std::shared_ptr<const FileEntry>& FilePtr() const { return file_; } //响应体引用的缓存文件，排队发送期间由发送队列持有
+    char* File(); //小文件内存映射的指针
+    int FileFd() const { return file_ ? file_->fd : -1; } //sendfile发送时的文件描述符，-1表示没有（小文件走mmap）
     size_t FileLen() const;
     void ErrorContent(Buffer& buff, std::string message); //错误处理函数
     int Code() const {
@@ -35,18 +56,36 @@ private:
     void AddContent_(Buffer& buff);
 
     void ErrorHtml_();
-    std::string GetFileType_();
+    bool NotModified_() const; //客户端缓存的版本是否仍然有效
+    void SelectVariant_(); //按Accept-Encoding把file_换成压缩版本
+    void ParseRange_(); //解析range_，生成ranges_，并把状态码改为206或416
+
+    //状态码对应的预先生成的字节块
+    struct StatusBlock {
+        int code;
+        std::string line; //状态行
+        std::string page; //错误页面路径（200为空）
+        std::string fallback; //错误页面文件不存在时发送的Content-type、Content-length和正文
+    };
+    static const StatusBlock& Status_(int code);
+    static std::string ErrorBlock_(int code, const std::string& message);
 
     int code_; //状态码
     bool isKeepAlive_; //是否长连接
 
     std::string path_; //响应资源的路径（如/index.html，即服务器要返回的文件路径）
     std::string srcDir_; //服务器静态资源的根目录（如./www，path_是相对于srcDir_ 的路径）
+    std::string ifNoneMatch_;
+    std::string ifModifiedSince_;
+    bool acceptEnc_[FileEntry::ENC_COUNT]; //客户端接受的压缩编码
+    std::string range_;
+    std::string ifRange_;
+    std::vector<BodyRange> ranges_;
+    std::string boundary_; //多段响应的分隔串
 
-    char* mmFile_; //内存映射文件的指针
-    struct stat mmFileStat_; //存储内存映射文件的状态
+    //从文件缓存取到的文件（stat结果、MIME类型、映射或文件描述符），响应发完前一直持有
+    std::shared_ptr<const FileEntry> file_;
 
-    static const std::unordered_map<std::string, std::string> SUFFIX_TYPE; //文件后缀名与MIME类型的映射
     static const std::unordered_map<int, std::string> CODE_STATUS; //状态码与状态描述的映射
     static const std::unordered_map<int, std::string> CODE_PATH; //状态码与错误页面路径的映射
 };
@@ -0,0 +1,223 @@
+#include "iouring.h"
+#include <signal.h>
+#include <time.h>
+
+//glibc 没有提供 io_uring 的系统调用包装，这里直接通过 syscall 调用
+static int SysSetup(unsigned entries, struct io_uring_params* p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int SysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags,
+                    const void* arg, size_t argSize) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+static int SysRegister(int fd, unsigned opcode, void* arg, unsigned nrArgs) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+IoUring::IoUring(unsigned entries)
+    : ringFd_(-1), features_(0), sqRing_(MAP_FAILED), sqRingSize_(0),
+      sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED)), sqesSize_(0), sqeTail_(0),
+      cqRing_(MAP_FAILED), cqRingSize_(0), bufRing_(nullptr), bufRingSize_(0), bufs_(nullptr), bufsSize_(0),
+      bufSize_(0), bufMask_(0) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = SysSetup(entries, &params);
+    if (fd < 0) {
+        return; //内核不支持或被禁用（ENOSYS/EPERM），由上层回退到 epoll
+    }
+    features_ = params.features;
+
+    //映射 SQ/CQ 环
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (features_ & IORING_FEAT_SINGLE_MMAP) {
+        if (cqRingSize_ > sqRingSize_) sqRingSize_ = cqRingSize_;
+        cqRingSize_ = sqRingSize_;
+    }
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        close(fd);
+        return;
+    }
+    if (features_ & IORING_FEAT_SINGLE_MMAP) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            munmap(sqRing_, sqRingSize_);
+            sqRing_ = MAP_FAILED;
+            close(fd);
+            return;
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        if (cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+        munmap(sqRing_, sqRingSize_);
+        sqRing_ = cqRing_ = MAP_FAILED;
+        close(fd);
+        return;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqeTail_ = *sqTail_;
+
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    ringFd_ = fd;
+
+    //探测内核支持的操作码
+    const unsigned probeOps = 256;
+    std::vector<char> probeBuf(sizeof(struct io_uring_probe) + probeOps * sizeof(struct io_uring_probe_op), 0);
+    struct io_uring_probe* probe = reinterpret_cast<struct io_uring_probe*>(probeBuf.data());
+    if (SysRegister(ringFd_, IORING_REGISTER_PROBE, probe, probeOps) == 0) {
+        ops_.assign(probe->last_op + 1, false);
+        for (unsigned i = 0; i < probe->ops_len && i < probeOps; i++) {
+            if (probe->ops[i].flags & IO_URING_OP_SUPPORTED) {
+                ops_[probe->ops[i].op] = true;
+            }
+        }
+    }
+}
+
+IoUring::~IoUring() {
+    if (ringFd_ < 0) return;
+    if (bufRing_) {
+        munmap(bufRing_, bufRingSize_);
+        munmap(bufs_, bufsSize_);
+    }
+    munmap(sqes_, sqesSize_);
+    if (cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+    munmap(sqRing_, sqRingSize_);
+    close(ringFd_);
+}
+
+bool IoUring::HasOp(int op) const {
+    return op >= 0 && static_cast<size_t>(op) < ops_.size() && ops_[op];
+}
+
+struct io_uring_sqe* IoUring::GetSqe() {
+    assert(IsOpen());
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (sqeTail_ - head >= *sqEntries_) {
+        return nullptr; //SQ 已满，调用方需先 Enter 提交
+    }
+    unsigned idx = sqeTail_ & *sqMask_;
+    struct io_uring_sqe* sqe = &sqes_[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray_[idx] = idx;
+    sqeTail_++;
+    return sqe;
+}
+
+unsigned IoUring::SqSpace() const {
+    return *sqEntries_ - (sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE));
+}
+
+void IoUring::Publish() {
+    //release 语义：保证 SQE 内容先于尾指针对内核可见
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+}
+
+int IoUring::Enter(unsigned minComplete, int timeoutMs) {
+    assert(IsOpen());
+    //只提交已发布但内核尚未取走的部分：to_submit 大于实际数量时内核会跳过等待直接返回
+    unsigned toSubmit = __atomic_load_n(sqTail_, __ATOMIC_RELAXED) - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    unsigned flags = 0;
+    if (minComplete > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+    if (minComplete == 0 || timeoutMs < 0) {
+        return SysEnter(ringFd_, toSubmit, minComplete, flags, nullptr, _NSIG / 8);
+    }
+    //带超时的等待（IORING_ENTER_EXT_ARG，5.11+）
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000000;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = reinterpret_cast<unsigned long long>(&ts);
+    flags |= IORING_ENTER_EXT_ARG;
+    int ret = SysEnter(ringFd_, toSubmit, minComplete, flags, &arg, sizeof(arg));
+    if (ret < 0 && errno == ETIME) {
+        return 0; //等待超时，不算错误
+    }
+    return ret;
+}
+
+struct io_uring_cqe* IoUring::PeekCqe() {
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        return nullptr;
+    }
+    return &cqes_[head & *cqMask_];
+}
+
+void IoUring::SeenCqe() {
+    __atomic_store_n(cqHead_, *cqHead_ + 1, __ATOMIC_RELEASE);
+}
+
+bool IoUring::SetupBufRing(unsigned count, unsigned bufSize, unsigned short group) {
+    assert(IsOpen() && !bufRing_ && count > 0 && (count & (count - 1)) == 0 && count <= 32768);
+    //环本身要求页对齐，用匿名映射；缓冲区在第一次被内核写入时才分配物理页（事件循环绑定CPU后落在本节点）
+    size_t ringSize = count * sizeof(struct io_uring_buf);
+    void* ring = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        return false;
+    }
+    size_t bufsSize = static_cast<size_t>(count) * bufSize;
+    void* bufs = mmap(nullptr, bufsSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufs == MAP_FAILED) {
+        munmap(ring, ringSize);
+        return false;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<unsigned long long>(ring);
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (SysRegister(ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        munmap(bufs, bufsSize);
+        munmap(ring, ringSize);
+        return false;
+    }
+    bufRing_ = static_cast<struct io_uring_buf_ring*>(ring);
+    bufRingSize_ = ringSize;
+    bufs_ = static_cast<char*>(bufs);
+    bufsSize_ = bufsSize;
+    bufSize_ = bufSize;
+    bufMask_ = count - 1;
+    for (unsigned i = 0; i < count; i++) {
+        RecycleBuf(static_cast<unsigned short>(i));
+    }
+    return true;
+}
+
+void IoUring::RecycleBuf(unsigned short bid) {
+    //环的尾指针与第一个缓冲区描述的保留字段重叠，这里只有上层（单线程）写入
+    //不用bufRing_->bufs：__DECLARE_FLEX_ARRAY在C++中展开出一个非空的占位结构，数组会偏移8字节
+    unsigned short tail = bufRing_->tail;
+    struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(bufRing_) + (tail & bufMask_);
+    buf->addr = reinterpret_cast<unsigned long long>(Buf(bid));
+    buf->len = bufSize_;
+    buf->bid = bid;
+    //release 语义：缓冲区描述先于尾指针对内核可见
+    __atomic_store_n(&bufRing_->tail, static_cast<unsigned short>(tail + 1), __ATOMIC_RELEASE);
+}
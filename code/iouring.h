@@ -0,0 +1,84 @@
+/*
+io_uring 的最小封装（不依赖 liburing，直接使用系统调用）：
+负责创建/映射提交队列（SQ）和完成队列（CQ），
+提供获取 SQE、提交、等待以及遍历 CQE 的接口，以及供多次recv使用的提供缓冲区环。
+上层（Epoller）在此之上实现与 epoll 相同的 AddFd/ModFd/DelFd/Wait 语义和连接的收发。
+*/
+
+#ifndef IOURING_H
+#define IOURING_H
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <vector>
+
+class IoUring {
+public:
+    explicit IoUring(unsigned entries = 1024);
+    ~IoUring();
+
+    bool IsOpen() const { return ringFd_ >= 0; }
+    unsigned Features() const { return features_; }
+    bool HasOp(int op) const; //内核是否支持某个操作码（来自 IORING_REGISTER_PROBE）
+
+    //获取一个空闲的 SQE，SQ 已满时返回 nullptr；填写完成后调用 Publish() 让内核可见
+    struct io_uring_sqe* GetSqe();
+    void Publish();
+    unsigned SqSpace() const; //SQ 中还能取的 SQE 数（链接的一组 SQE 必须在同一次提交中）
+
+    //提交所有已发布的 SQE；minComplete > 0 时阻塞等待完成事件，timeoutMs < 0 表示无限等待
+    //返回值与 io_uring_enter 一致，失败时返回 -1 并设置 errno
+    int Enter(unsigned minComplete, int timeoutMs);
+
+    //完成队列遍历：PeekCqe 获取队首（没有则返回 nullptr），处理完后调用 SeenCqe 出队
+    struct io_uring_cqe* PeekCqe();
+    void SeenCqe();
+
+    //提供缓冲区环（IORING_REGISTER_PBUF_RING，5.19+）：count（2的幂）个 bufSize 字节的缓冲区，组号为 group
+    //设置了 IOSQE_BUFFER_SELECT 的 recv 由内核从环中取缓冲区，CQE 的 flags 中带缓冲区编号
+    bool SetupBufRing(unsigned count, unsigned bufSize, unsigned short group);
+    bool HasBufRing() const { return bufRing_ != nullptr; }
+    char* Buf(unsigned short bid) const { return bufs_ + static_cast<size_t>(bid) * bufSize_; }
+    //用完的缓冲区还给内核，只能单线程调用（由上层加锁）
+    void RecycleBuf(unsigned short bid);
+
+private:
+    int ringFd_;
+    unsigned features_;
+    std::vector<bool> ops_; //probe 结果：下标为操作码
+
+    //SQ 环
+    void* sqRing_;
+    size_t sqRingSize_;
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqMask_;
+    unsigned* sqEntries_;
+    unsigned* sqArray_;
+    struct io_uring_sqe* sqes_;
+    size_t sqesSize_;
+    unsigned sqeTail_; //本地维护的尾指针（尚未发布的 SQE 在 [*sqTail_, sqeTail_) 之间）
+
+    //CQ 环（内核支持 IORING_FEAT_SINGLE_MMAP 时与 SQ 环共用一段映射）
+    void* cqRing_;
+    size_t cqRingSize_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned* cqMask_;
+    struct io_uring_cqe* cqes_;
+
+    //提供缓冲区环
+    struct io_uring_buf_ring* bufRing_;
+    size_t bufRingSize_;
+    char* bufs_;
+    size_t bufsSize_;
+    unsigned bufSize_;
+    unsigned bufMask_;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "log.h"
+#include "cpuplacement.h"
 
 Log::Log() {
     fp_ = nullptr;
@@ -166,6 +167,7 @@ void Log::write(int level, const char* format, ...) {
         std::unique_lock<std::mutex> locker(mtx_);
         lineCount_++;
         //拼接时间戳
+        buff_.EnsureWritable(128);
         int n = snprintf(buff_.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
                     t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
                     t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
@@ -176,9 +178,13 @@ void Log::write(int level, const char* format, ...) {
         va_start(vaList, format); //初始化可变参数列表
         //snprintf直接接收可变参数
         //而vsnprintf接收的是va_list类型的参数
-        int m = vsnprintf(buff_.BeginWrite(), buff_.WritableBytes(), format, vaList);
+        size_t writable = buff_.WritableBytes();
+        int m = vsnprintf(buff_.BeginWrite(), writable, format, vaList);
         va_end(vaList); //结束可变参数的获取
 
+        if (m >= static_cast<int>(writable)) {
+            m = static_cast<int>(writable) - 1; //超出当前块的部分被截断
+        }
         buff_.HasWritten(m); //缓冲区指针移动
     buff_.Append("\n", 1); // 换行
 
@@ -187,7 +193,7 @@ void Log::write(int level, const char* format, ...) {
             deque_->push_back(buff_.RetrieveAllToStr());
         } else {    // 同步方式（直接向文件中写入日志信息）
             if (fp_) {
-                fputs(buff_.Peek(), fp_);   // 同步就直接写入文件
+                fwrite(buff_.Peek(), 1, buff_.ReadableBytes(), fp_);   // 同步就直接写入文件
             }
         }
         buff_.RetrieveAll();    //清空缓冲区，释放空间供下次使用
@@ -224,4 +230,10 @@ int Log::GetLevel() {
 void Log::SetLevel(int level) {
     std::lock_guard<std::mutex> locker(mtx_);
     level_ = level;
-}
\ No newline at end of file
+}
+bool Log::PinWriter(int cpu) {
+    if (!writeThread_) {
+        return false;
+    }
+    return CpuPlacement::Pin(writeThread_->native_handle(), cpu);
+}
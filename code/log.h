@@ -29,6 +29,7 @@ public:
     int GetLevel();
     void SetLevel(int level);
     bool IsOpen() { return isOpen_; }
+    bool PinWriter(int cpu); //把异步写线程绑定到指定CPU（同步日志时返回false）
 
 private:
     Log();
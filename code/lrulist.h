@@ -0,0 +1,84 @@
+/*
+按最近活动排序的连接链表（内存预算超限时淘汰最久没有活动的空闲连接）：
+节点按fd下标存放在数组中，用下标串成双向链表，表头最旧、表尾最新，
+Touch/Remove 都是O(1)。只由所属事件循环线程访问，不加锁。
+*/
+
+#ifndef LRULIST_H
+#define LRULIST_H
+
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+#include <assert.h>
+
+class LruList {
+public:
+    LruList() : head_(-1), tail_(-1), size_(0) {}
+
+    //id有活动：移到表尾，不在表中时加入
+    void Touch(int id) {
+        assert(id >= 0);
+        if (static_cast<size_t>(id) >= nodes_.size()) {
+            nodes_.resize(std::max(static_cast<size_t>(id) + 1, nodes_.size() * 2));
+        }
+        Node& node = nodes_[id];
+        if (node.linked) {
+            if (tail_ == id) {
+                return;
+            }
+            Unlink_(id);
+        }
+        node.prev = tail_;
+        node.next = -1;
+        node.linked = true;
+        if (tail_ >= 0) {
+            nodes_[tail_].next = id;
+        } else {
+            head_ = id;
+        }
+        tail_ = id;
+        size_++;
+    }
+
+    void Remove(int id) {
+        if (id >= 0 && static_cast<size_t>(id) < nodes_.size() && nodes_[id].linked) {
+            Unlink_(id);
+        }
+    }
+
+    int Front() const { return head_; } //最久没有活动的id，空表返回-1
+    int Next(int id) const { return nodes_[id].next; } //比id新的下一个，没有返回-1
+    size_t Size() const { return size_; }
+
+private:
+    struct Node {
+        int prev = -1;
+        int next = -1;
+        bool linked = false;
+    };
+
+    void Unlink_(int id) {
+        Node& node = nodes_[id];
+        if (node.prev >= 0) {
+            nodes_[node.prev].next = node.next;
+        } else {
+            head_ = node.next;
+        }
+        if (node.next >= 0) {
+            nodes_[node.next].prev = node.prev;
+        } else {
+            tail_ = node.prev;
+        }
+        node.prev = node.next = -1;
+        node.linked = false;
+        size_--;
+    }
+
+    std::vector<Node> nodes_; //按id（fd）下标存放的节点，只增不减
+    int head_;
+    int tail_;
+    size_t size_;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+无锁多生产者单消费者有界队列（Vyukov 有界环形队列的MPSC版本）：
+槽位在构造时一次分配，投递命令不再逐个new节点；每个槽带序号，生产者用一次CAS占位，
+唯一的消费者按顺序取出，无需CAS。
+用于工作线程向事件循环投递命令：任意线程Push，只有事件循环线程Pop；队列满时Push返回false，由调用方决定如何等待。
+*/
+
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <stdint.h>
+#include <assert.h>
+
+template<class T>
+class MpscQueue {
+public:
+    //capacity必须是2的幂
+    explicit MpscQueue(size_t capacity) : mask_(capacity - 1), cells_(new Cell[capacity]), enq_(0), deq_(0) {
+        (void)pad_;
+        assert(capacity > 0 && (capacity & mask_) == 0);
+        for (size_t i = 0; i < capacity; i++) {
+            cells_[i].seq_.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    //任意线程调用；队列已满时返回false
+    bool Push(const T& item) {
+        size_t pos = enq_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq_.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enq_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false; //已满
+            } else {
+                pos = enq_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->item_ = item;
+        cell->seq_.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    //只能由唯一的消费者线程调用；队列为空（或生产者占了槽还没写完）时返回false
+    bool Pop(T& item) {
+        Cell* cell = &cells_[deq_ & mask_];
+        if (cell->seq_.load(std::memory_order_acquire) != deq_ + 1) {
+            return false;
+        }
+        item = std::move(cell->item_);
+        cell->seq_.store(deq_ + mask_ + 1, std::memory_order_release);
+        deq_++;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq_;
+        T item_;
+    };
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    std::atomic<size_t> enq_; //生产者竞争
+    char pad_[64]; //enq_与deq_分在不同缓存行
+    size_t deq_; //只有消费者访问
+};
+
+#endif
@@ -0,0 +1,220 @@
+#include "resourcewatcher.h"
+#include <atomic>
+#include <chrono>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+using namespace std;
+
+//文件内容或元数据变化：写完关闭、移入/移出、创建/删除、改权限
+static const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE
+                                 | IN_DELETE | IN_ATTRIB | IN_DELETE_SELF | IN_ONLYDIR;
+
+ResourceWatcher::ResourceWatcher() : inotifyFd_(-1), stopFd_(-1) {}
+
+ResourceWatcher::~ResourceWatcher() {
+    Stop();
+}
+
+bool ResourceWatcher::Start(const string& root) {
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd_ < 0 || stopFd_ < 0) {
+        LOG_WARN("inotify unavailable (errno: %d), static files are revalidated by stat", errno);
+        Stop();
+        return false;
+    }
+    root_ = root;
+    AddTree_(root);
+    if (dirs_.empty()) {
+        Stop();
+        return false;
+    }
+    thread_ = thread(&ResourceWatcher::Loop_, this);
+    return true;
+}
+
+void ResourceWatcher::Stop() {
+    if (thread_.joinable()) {
+        uint64_t one = 1;
+        if (write(stopFd_, &one, sizeof(one)) < 0) {
+            LOG_ERROR("wake resource watcher failed, errno: %d", errno);
+        }
+        thread_.join();
+    }
+    if (inotifyFd_ >= 0) close(inotifyFd_);
+    if (stopFd_ >= 0) close(stopFd_);
+    inotifyFd_ = stopFd_ = -1;
+    dirs_.clear();
+}
+
+void ResourceWatcher::ListTree_(const string& dir, vector<string>* files, vector<string>* dirs) {
+    if (dirs) dirs->push_back(dir);
+    DIR* dp = opendir(dir.c_str());
+    if (!dp) {
+        return;
+    }
+    while (struct dirent* de = readdir(dp)) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+            continue;
+        }
+        string path = dir + "/" + de->d_name;
+        unsigned char type = de->d_type;
+        if (type == DT_UNKNOWN || type == DT_LNK) {
+            struct stat st;
+            if (stat(path.c_str(), &st) < 0) continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : (S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN);
+        }
+        if (type == DT_DIR && de->d_type != DT_LNK) { //不跟随目录的符号链接，避免成环
+            ListTree_(path, files, dirs);
+        } else if (type == DT_REG && files) {
+            files->push_back(path);
+        }
+    }
+    closedir(dp);
+}
+
+void ResourceWatcher::AddTree_(const string& dir) {
+    vector<string> dirs;
+    ListTree_(dir, nullptr, &dirs);
+    for (const string& d : dirs) {
+        int wd = inotify_add_watch(inotifyFd_, d.c_str(), WATCH_MASK);
+        if (wd < 0) {
+            LOG_WARN("inotify_add_watch %s failed, errno: %d", d.c_str(), errno);
+            continue;
+        }
+        dirs_[wd] = d;
+    }
+}
+
+bool ResourceWatcher::Stopping_() const {
+    struct pollfd pfd = { stopFd_, POLLIN, 0 };
+    return poll(&pfd, 1, 0) > 0;
+}
+
+void ResourceWatcher::Loop_() {
+    //先为已有的文件生成gzip版本（预热已经生成过的直接跳过）；期间的变化事件留在inotify队列中，之后再处理
+    vector<string> files;
+    ListTree_(root_, &files, nullptr);
+    for (const string& path : files) {
+        if (Stopping_()) {
+            return;
+        }
+        FileCache::Instance()->Precompress(path);
+    }
+    //inotify_event后面紧跟变长的文件名，按事件结构体对齐
+    alignas(struct inotify_event) char buf[16 * 1024];
+    struct pollfd fds[2] = { { inotifyFd_, POLLIN, 0 }, { stopFd_, POLLIN, 0 } };
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("resource watcher poll failed, errno: %d", errno);
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+        while (true) {
+            ssize_t len = read(inotifyFd_, buf, sizeof(buf));
+            if (len <= 0) {
+                break; //EAGAIN：本批事件处理完
+            }
+            for (char* p = buf; p < buf + len;) {
+                const struct inotify_event* ev = reinterpret_cast<const struct inotify_event*>(p);
+                Handle_(ev);
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+    }
+}
+
+void ResourceWatcher::Handle_(const struct inotify_event* ev) {
+    FileCache* cache = FileCache::Instance();
+    if (ev->mask & IN_Q_OVERFLOW) {
+        LOG_WARN("inotify queue overflow, file cache cleared");
+        cache->Clear();
+        return;
+    }
+    auto it = dirs_.find(ev->wd);
+    if (it == dirs_.end()) {
+        return;
+    }
+    if (ev->mask & IN_IGNORED) {
+        dirs_.erase(it); //目录被删除，监视已被内核移除
+        return;
+    }
+    if (ev->len == 0) {
+        return; //目录自身的事件（IN_DELETE_SELF），由父目录的事件处理
+    }
+    string path = it->second + "/" + ev->name;
+    if (ev->mask & IN_ISDIR) {
+        if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+            AddTree_(path); //新目录（可能已有文件）加入监视
+        }
+        cache->InvalidatePrefix(path + "/"); //目录被移走/替换：其下缓存的文件全部作废
+        return;
+    }
+    LOG_DEBUG("resource changed: %s (mask 0x%x)", path.c_str(), ev->mask);
+    cache->Refresh(path);
+    //预先压缩好的文件变化时，原文件的压缩版本需要重新加载
+    static const char* SUFFIX[] = { ".gz", ".br" };
+    for (const char* suffix : SUFFIX) {
+        size_t n = strlen(suffix);
+        if (path.size() > n && path.compare(path.size() - n, n, suffix) == 0) {
+            cache->Refresh(path.substr(0, path.size() - n));
+        }
+    }
+}
+
+int ResourceWatcher::WarmUp(const string& root, int threads) {
+    vector<string> files;
+    ListTree_(root, &files, nullptr);
+    if (files.empty()) {
+        return 0;
+    }
+    threads = max(1, min(threads, static_cast<int>(files.size())));
+    auto start = chrono::steady_clock::now();
+    atomic<size_t> next(0), done(0);
+    atomic<size_t> bytes(0);
+    auto work = [&]() {
+        size_t i;
+        while ((i = next.fetch_add(1)) < files.size()) {
+            FileCache::Instance()->Precompress(files[i]);
+            shared_ptr<const FileEntry> entry = FileCache::Instance()->Get(files[i]);
+            if (entry) {
+                //映射的内容逐页读一遍；走sendfile的文件让内核预读进页缓存
+                if (entry->data && entry->mapped) {
+                    volatile char sink = 0;
+                    for (off_t off = 0; off < entry->st.st_size; off += 4096) {
+                        sink = sink + entry->data[off];
+                    }
+                } else if (entry->fd >= 0) {
+                    posix_fadvise(entry->fd, 0, 0, POSIX_FADV_WILLNEED);
+                }
+                bytes += entry->st.st_size;
+            }
+            size_t n = done.fetch_add(1) + 1;
+            if (n * 10 / files.size() != (n - 1) * 10 / files.size()) {
+                LOG_INFO("File cache warm-up: %d/%d files (%d%%)", (int)n, (int)files.size(),
+                         (int)(n * 100 / files.size()));
+            }
+        }
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (auto& t : pool) {
+        t.join();
+    }
+    long ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    LOG_INFO("File cache warm-up done: %d files, %d KB in %ld ms with %d threads",
+             (int)files.size(), (int)(bytes / 1024), ms, threads);
+    return static_cast<int>(files.size());
+}
@@ -0,0 +1,51 @@
+/*
+静态资源目录的监视与预热：
+- 监视：后台线程用inotify递归监视资源根目录，文件被改写、替换、删除或改权限后，
+  立即刷新FileCache中对应的项（.br/.gz变化时刷新原文件），不重启服务也能上线新页面；
+  新建的子目录自动加入监视，队列溢出时清空整个缓存；监视线程启动后先为所有可压缩的文件生成gzip版本。
+- 预热：启动时多线程把目录下所有文件加载进FileCache（同时生成gzip版本）并读入内存，部署后的第一批请求不会碰到冷磁盘。
+压缩只在这两处的后台线程上进行，工作线程从不压缩。
+*/
+
+#ifndef RESOURCEWATCHER_H
+#define RESOURCEWATCHER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <unordered_map>
+#include <sys/inotify.h>
+
+#include "log.h"
+#include "filecache.h"
+
+class ResourceWatcher {
+public:
+    ResourceWatcher();
+    ~ResourceWatcher();
+    ResourceWatcher(const ResourceWatcher&) = delete;
+    ResourceWatcher& operator=(const ResourceWatcher&) = delete;
+
+    bool Start(const std::string& root); //监视root及其所有子目录，失败返回false（缓存继续按间隔确认）
+    void Stop();
+    size_t WatchCount() const { return dirs_.size(); } //监视的目录数（Start之后、监视线程运行前有效）
+
+    //把root下所有文件加载进FileCache，threads个线程并行，按10%报告进度；返回加载的文件数
+    static int WarmUp(const std::string& root, int threads);
+
+private:
+    void AddTree_(const std::string& dir); //监视dir及其子目录
+    void Loop_();
+    bool Stopping_() const; //Stop已经请求监视线程退出
+    void Handle_(const struct inotify_event* ev);
+
+    static void ListTree_(const std::string& dir, std::vector<std::string>* files, std::vector<std::string>* dirs);
+
+    int inotifyFd_;
+    int stopFd_; //eventfd，Stop时唤醒监视线程
+    std::string root_; //监视的资源根目录
+    std::unordered_map<int, std::string> dirs_; //watch描述符 -> 目录路径（线程启动后只由监视线程访问）
+    std::thread thread_;
+};
+
+#endif
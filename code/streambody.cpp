@@ -0,0 +1,81 @@
+#include "streambody.h"
+#include <stdio.h>
+
+void StreamBody::Begin_(Buffer* buff, bool chunked) {
+    buff_ = buff;
+    chunked_ = chunked;
+    flush_ = false;
+    first_ = true;
+    pending_.clear();
+    framed_ = written_ = 0;
+}
+
+//小段内容先攒在pending_中；不小于一块的内容直接成块，不经过暂存
+void StreamBody::Write(const char* data, size_t len) {
+    written_ += len;
+    if (len >= CHUNK_SIZE) {
+        FramePending_();
+        Frame_(data, len);
+        return;
+    }
+    pending_.append(data, len);
+    if (pending_.size() >= CHUNK_SIZE) {
+        FramePending_();
+    }
+}
+
+void StreamBody::Flush() {
+    FramePending_();
+    flush_ = true;
+}
+
+void StreamBody::End_() {
+    FramePending_();
+    if (chunked_) {
+        buff_->Append("0\r\n\r\n", 5);
+        framed_ += 5;
+    }
+    std::string().swap(pending_); //长连接空闲时不占用暂存区
+}
+
+bool StreamBody::TakeFlush_() {
+    if (first_) {
+        FramePending_();
+        first_ = false;
+        flush_ = true;
+    }
+    bool flush = flush_;
+    flush_ = false;
+    return flush;
+}
+
+size_t StreamBody::TakeFramed_() {
+    size_t n = framed_;
+    framed_ = 0;
+    return n;
+}
+
+void StreamBody::FramePending_() {
+    if (!pending_.empty()) {
+        Frame_(pending_.data(), pending_.size());
+        pending_.clear();
+    }
+}
+
+//一块：十六进制长度CRLF、内容、CRLF
+void StreamBody::Frame_(const char* data, size_t len) {
+    if (len == 0) {
+        return; //长度为0的块表示结束，不能出现在中间
+    }
+    if (chunked_) {
+        char head[24];
+        int n = snprintf(head, sizeof(head), "%zx\r\n", len);
+        buff_->Append(head, n);
+        buff_->Append(data, len);
+        buff_->Append("\r\n", 2);
+        framed_ += n + len + 2;
+    } else {
+        buff_->Append(data, len);
+        framed_ += len;
+    }
+}
@@ -0,0 +1,55 @@
+/*
+流式响应体：处理函数分多次产生内容，不必先把整个响应体生成出来。
+- 注册在某个路径上的Handler为每个请求返回一个Producer，HttpConn在发送队列快空时反复调用它，
+  每次调用写入一部分内容，返回false表示响应结束；
+- 写入的内容凑满CHUNK_SIZE成为一块，按Transfer-Encoding: chunked的格式直接追加到连接的写缓冲区，
+  和其他响应一样经发送队列由sendmsg发出（HTTP/1.0没有分块编码，原样发送，以关闭连接结束响应）；
+- 背压：发送队列达到高水位后不再调用Producer，socket发送缓冲区满时连接等待可写，
+  Producer随之暂停，直到数据发出、队列回落到低水位才继续；
+- Flush()把已写的内容立即成块并结束本轮调用，让它尽快发出；第一次调用结束后自动Flush，
+  响应头和第一部分内容不等凑满就发送，首字节时间不受块大小影响。
+Producer在处理连接的线程上被调用（线程池模式为工作线程，协程模式为事件循环线程），每次调用都应写入内容或结束，
+不能阻塞等待。
+*/
+
+#ifndef STREAM_BODY_H
+#define STREAM_BODY_H
+
+#include <string>
+#include <functional>
+
+#include "buffer.h"
+
+class HttpRequest;
+
+class StreamBody {
+public:
+    typedef std::function<bool(StreamBody& out)> Producer;
+    typedef std::function<Producer(const HttpRequest& req)> Handler; //返回空的Producer表示响应体为空
+
+    void Write(const char* data, size_t len);
+    void Write(const std::string& str) { Write(str.data(), str.size()); }
+    void Flush(); //已写的内容立即成块发出，不等凑满
+    size_t Written() const { return written_; } //本响应已写入的字节数
+
+private:
+    friend class HttpConn;
+    static const size_t CHUNK_SIZE = 16 * 1024; //凑满这么多才成块，块太小时分块头和系统调用的开销占比高
+
+    void Begin_(Buffer* buff, bool chunked);
+    void End_(); //剩下的内容成块，并追加结束块
+    bool TakeFlush_(); //本轮调用是否要求立即发送
+    size_t TakeFramed_(); //上次以来追加到写缓冲区的字节数
+    void FramePending_();
+    void Frame_(const char* data, size_t len);
+
+    Buffer* buff_ = nullptr; //连接的写缓冲区
+    bool chunked_ = false;
+    bool flush_ = false;
+    bool first_ = false; //第一次调用还没结束
+    std::string pending_; //不足一块的内容
+    size_t framed_ = 0;
+    size_t written_ = 0;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*
+线程池任务类型（替代 std::function<void()>）：
+- Task：定长、只可移动的小对象缓冲区任务，可调用对象直接构造在内部缓冲区中，
+  超出缓冲区大小的可调用对象在编译期报错，因此构造/移动/执行都不会分配内存；
+- TaskNode：侵入式任务节点，嵌入在长期存在的对象（如 HttpConn）中，
+  线程池队列只保存节点指针，投递时完全不需要构造任务对象。
+*/
+
+#ifndef TASK_H
+#define TASK_H
+
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <stddef.h>
+
+class Task {
+public:
+    static const size_t CAPACITY = 64 - sizeof(void*); //整个Task占一个缓存行
+
+    Task() : ops_(nullptr) {}
+
+    template<class F, class D = typename std::decay<F>::type,
+             class = typename std::enable_if<!std::is_same<D, Task>::value>::type>
+    Task(F&& f) : ops_(&OpsFor<D>::ops) {
+        static_assert(sizeof(D) <= CAPACITY, "callable too large for Task, capture less or use a pointer");
+        static_assert(alignof(D) <= alignof(void*), "callable over-aligned for Task");
+        new (buf_) D(std::forward<F>(f));
+    }
+
+    Task(Task&& other) noexcept : ops_(other.ops_) {
+        if (ops_) {
+            ops_->move(buf_, other.buf_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            ops_ = other.ops_;
+            if (ops_) {
+                ops_->move(buf_, other.buf_);
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { Reset(); }
+
+    void operator()() { ops_->call(buf_); }
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    void Reset() {
+        if (ops_) {
+            ops_->destroy(buf_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*call)(void*);
+        void (*move)(void* dst, void* src); //移动构造到dst并析构src
+        void (*destroy)(void*);
+    };
+
+    template<class D>
+    struct OpsFor {
+        static void Call(void* p) { (*static_cast<D*>(p))(); }
+        static void Move(void* dst, void* src) {
+            new (dst) D(std::move(*static_cast<D*>(src)));
+            static_cast<D*>(src)->~D();
+        }
+        static void Destroy(void* p) { static_cast<D*>(p)->~D(); }
+        static const Ops ops;
+    };
+
+    const Ops* ops_;
+    alignas(void*) unsigned char buf_[CAPACITY];
+};
+
+template<class D>
+const Task::Ops Task::OpsFor<D>::ops = { &Task::OpsFor<D>::Call, &Task::OpsFor<D>::Move, &Task::OpsFor<D>::Destroy };
+
+//侵入式任务节点：所有者负责节点的生命周期，同一节点在执行前不能重复投递
+struct TaskNode {
+    void (*run_)(TaskNode*) = nullptr; //执行函数，参数为节点自身（可通过派生类取回上下文）
+    void Run() { run_(this); }
+};
+
+#endif
@@ -6,9 +6,12 @@
 #include <condition_variable>
 #include <thread>
 #include <functional>
+#include <type_traits>
 #include <assert.h>
 #include <vector>
 
+#include "task.h"
+
 class ThreadPool {
 public:
     ThreadPool() = default;
@@ -51,7 +54,7 @@ public:
         }
     }
 
-    template<typename T>
+    template<typename T, class = typename std::enable_if<!std::is_convertible<T, TaskNode*>::value>::type>
     void AddTask(T&& task) {
         std::unique_lock<std::mutex> locker(pool_->mtx_);
         //std::forward<T>(task)完美转发，保持task的原始值类别（左值/右值）
@@ -59,12 +62,17 @@ public:
         pool_->cv_.notify_one();
     }
 
+    //侵入式任务节点：队列中只保存节点指针
+    void AddTask(TaskNode* node) {
+        AddTask([node]() { node->Run(); });
+    }
+
 private:
     struct Pool {
         std::mutex mtx_;
         std::condition_variable cv_;
         bool isClosed_ = false;
-        std::queue<std::function<void()>> tasks_; //任务队列
+        std::queue<Task> tasks_; //任务队列（小对象缓冲区任务，入队不分配内存）
     };
     std::shared_ptr<Pool> pool_;
     std::vector<std::thread> workers_;
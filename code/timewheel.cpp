@@ -0,0 +1,215 @@
+#include "timewheel.h"
+#include <algorithm>
+using namespace std;
+
+//循环右移，使位图中“下一个槽”落在第0位
+static inline uint64_t RotateRight(uint64_t x, unsigned k) {
+    k &= 63;
+    return k ? (x >> k) | (x << (64 - k)) : x;
+}
+
+TimeWheel::TimeWheel() : count_(0) {
+    for (int i = 0; i < LEVELS * SLOTS; i++) {
+        heads_[i] = -1;
+    }
+    for (int l = 0; l < LEVELS; l++) {
+        bitmap_[l] = 0;
+    }
+    UpdateNow();
+    current_ = static_cast<uint64_t>(nowMs_ / TICK_MS);
+}
+
+void TimeWheel::UpdateNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    nowMs_ = static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+//按到期格与当前格的距离选择层：距离小于64^(l+1)的放在第l层
+void TimeWheel::Link_(int id, uint64_t tick) {
+    Node& node = nodes_[id];
+    assert(node.slot < 0 && tick >= current_);
+    uint64_t delta = tick - current_;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ULL << (LEVEL_BITS * (level + 1)))) {
+        level++;
+    }
+    if (delta >= (1ULL << (LEVEL_BITS * LEVELS))) {
+        tick = current_ + (1ULL << (LEVEL_BITS * LEVELS)) - 1; //超出时间轮范围，先放在最高层，下放时再重新计算
+    }
+    int idx = static_cast<int>((tick >> (LEVEL_BITS * level)) & (SLOTS - 1));
+    int slot = level * SLOTS + idx;
+    node.tick = tick;
+    node.slot = slot;
+    node.prev = -1;
+    node.next = heads_[slot];
+    if (node.next >= 0) {
+        nodes_[node.next].prev = id;
+    }
+    heads_[slot] = id;
+    bitmap_[level] |= (1ULL << idx);
+    count_++;
+}
+
+void TimeWheel::Unlink_(int id) {
+    Node& node = nodes_[id];
+    assert(node.slot >= 0);
+    if (node.prev >= 0) {
+        nodes_[node.prev].next = node.next;
+    } else {
+        heads_[node.slot] = node.next;
+    }
+    if (node.next >= 0) {
+        nodes_[node.next].prev = node.prev;
+    }
+    if (heads_[node.slot] < 0) {
+        bitmap_[node.slot / SLOTS] &= ~(1ULL << (node.slot % SLOTS));
+    }
+    node.prev = node.next = node.slot = -1;
+    count_--;
+}
+
+void TimeWheel::Schedule_(int id, uint64_t minTick) {
+    uint64_t tick = ToTick_(nodes_[id].expires);
+    Link_(id, tick > minTick ? tick : minTick);
+}
+
+//上层当前槽中的节点距离到期已不足一整圈，按到期时间重新挂到下层
+void TimeWheel::Cascade_(int level) {
+    int slot = level * SLOTS + static_cast<int>((current_ >> (LEVEL_BITS * level)) & (SLOTS - 1));
+    while (heads_[slot] >= 0) {
+        int id = heads_[slot];
+        Unlink_(id);
+        Schedule_(id, current_); //本格接下来就会处理
+    }
+}
+
+//惰性过期：槽到期时才检查节点真正的到期时间，被刷新过的节点重新挂载
+void TimeWheel::Expire_() {
+    int slot = static_cast<int>(current_ & (SLOTS - 1));
+    //回调中可能删除同一个槽中的其他节点，因此每次都从链表头取
+    while (heads_[slot] >= 0) {
+        int id = heads_[slot];
+        Unlink_(id);
+        Node& node = nodes_[id];
+        if (node.expires > nowMs_) {
+            Schedule_(id, current_ + 1);
+            continue;
+        }
+        TimeoutCallBack cb;
+        cb.swap(node.cb); //回调中可能对同一个id重新add
+        if (cb) cb();
+    }
+}
+
+uint64_t TimeWheel::NextTick_() const {
+    if (count_ == 0) {
+        return 0;
+    }
+    uint64_t next = UINT64_MAX;
+    //第0层：从下一格开始的第一个非空槽
+    if (bitmap_[0]) {
+        uint64_t base = current_ + 1;
+        next = base + __builtin_ctzll(RotateRight(bitmap_[0], static_cast<unsigned>(base & (SLOTS - 1))));
+    }
+    //上层：第一个非空槽下放的时刻
+    for (int l = 1; l < LEVELS; l++) {
+        if (!bitmap_[l]) continue;
+        int shift = LEVEL_BITS * l;
+        uint64_t base = (current_ >> shift) + 1;
+        uint64_t t = (base + __builtin_ctzll(RotateRight(bitmap_[l], static_cast<unsigned>(base & (SLOTS - 1))))) << shift;
+        if (t < next) next = t;
+    }
+    return next;
+}
+
+//只在有事件的格上停留，中间的空格直接跳过
+void TimeWheel::Advance_(uint64_t target) {
+    while (current_ < target) {
+        uint64_t next = NextTick_();
+        if (next == 0 || next > target) {
+            current_ = target;
+            return;
+        }
+        current_ = next;
+        for (int l = LEVELS - 1; l > 0; l--) {
+            if ((current_ & ((1ULL << (LEVEL_BITS * l)) - 1)) == 0) {
+                Cascade_(l);
+            }
+        }
+        Expire_();
+    }
+}
+
+void TimeWheel::add(int id, int timeOut, const TimeoutCallBack& cb) {
+    assert(id >= 0);
+    if (static_cast<size_t>(id) >= nodes_.size()) {
+        nodes_.resize(max(static_cast<size_t>(id) + 1, nodes_.size() * 2));
+    }
+    Node& node = nodes_[id];
+    if (node.slot >= 0) {
+        Unlink_(id);
+    }
+    node.cb = cb;
+    node.expires = nowMs_ + timeOut;
+    Schedule_(id, current_ + 1);
+}
+
+//刷新只记录新的到期时间；只有提前到期（比挂载的格更早）时才需要重新挂载
+void TimeWheel::adjust(int id, int newExpires) {
+    if (id < 0 || static_cast<size_t>(id) >= nodes_.size() || nodes_[id].slot < 0) {
+        return;
+    }
+    Node& node = nodes_[id];
+    node.expires = nowMs_ + newExpires;
+    if (ToTick_(node.expires) < node.tick) {
+        Unlink_(id);
+        Schedule_(id, current_ + 1);
+    }
+}
+
+void TimeWheel::cancel(int id) {
+    if (id < 0 || static_cast<size_t>(id) >= nodes_.size() || nodes_[id].slot < 0) {
+        return;
+    }
+    Unlink_(id);
+    nodes_[id].cb = nullptr; //释放回调捕获的资源
+}
+
+void TimeWheel::doWork(int id) {
+    if (id < 0 || static_cast<size_t>(id) >= nodes_.size() || nodes_[id].slot < 0) {
+        return;
+    }
+    Unlink_(id);
+    TimeoutCallBack cb;
+    cb.swap(nodes_[id].cb);
+    if (cb) cb();
+}
+
+void TimeWheel::clear() {
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        nodes_[i] = Node();
+    }
+    for (int i = 0; i < LEVELS * SLOTS; i++) {
+        heads_[i] = -1;
+    }
+    for (int l = 0; l < LEVELS; l++) {
+        bitmap_[l] = 0;
+    }
+    count_ = 0;
+}
+
+void TimeWheel::tick() {
+    Advance_(static_cast<uint64_t>(nowMs_ / TICK_MS));
+}
+
+int TimeWheel::GetNextTick() {
+    UpdateNow();
+    tick(); //先处理已经超时的连接
+    uint64_t next = NextTick_();
+    if (next == 0) {
+        return -1;
+    }
+    int64_t res = static_cast<int64_t>(next) * TICK_MS - nowMs_;
+    return res < 0 ? 0 : static_cast<int>(res);
+}
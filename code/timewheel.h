@@ -0,0 +1,69 @@
+/*
+分层时间轮（管理连接的空闲超时，取代了原先的最小堆定时器HeapTimer）：
+4层，每层64个槽，第0层一格为 TICK_MS 毫秒，上一层一格等于下一层一整圈；
+节点按fd下标存放在数组中，用下标串成槽内的双向链表，增加/刷新/删除都是O(1)。
+刷新超时采用惰性过期：adjust只记录新的到期时间，节点留在原来的槽里，
+槽到期时再检查，未到期的节点按新的到期时间重新挂到对应的槽中。
+时间取自事件循环缓存的 CLOCK_MONOTONIC_COARSE，每轮循环只读一次时钟。
+接口沿用原先HeapTimer的add/adjust/doWork/GetNextTick。
+*/
+
+#ifndef TIMEWHEEL_H
+#define TIMEWHEEL_H
+
+#include <functional>
+#include <vector>
+#include <stdint.h>
+#include <assert.h>
+#include <time.h>
+
+typedef std::function<void()> TimeoutCallBack;
+
+class TimeWheel {
+public:
+    TimeWheel();
+    ~TimeWheel() { clear(); }
+
+    void adjust(int id, int newExpires); //刷新id的超时时间（惰性：只记录新的到期时间）
+    void add(int id, int timeOut, const TimeoutCallBack& cb); //添加超时事件，id已存在时重新设置
+    void cancel(int id); //删除id的超时事件（不执行回调）
+    void doWork(int id); //立即执行id对应的超时回调，并删除该节点
+    void clear(); //清空所有超时事件
+    void tick(); //处理所有已超时的事件
+    int GetNextTick(); //获取距离下一次需要处理时间轮的毫秒数，没有事件时返回-1
+
+    void UpdateNow(); //刷新缓存的当前时间（事件循环每次从Wait返回后调用）
+
+private:
+    static const int TICK_MS = 4; //第0层一格的毫秒数（与粗粒度时钟的精度相当）
+    static const int LEVEL_BITS = 6;
+    static const int SLOTS = 1 << LEVEL_BITS; //每层槽数
+    static const int LEVELS = 4; //层数，最大约 4ms * 64^4 = 4.6小时，更远的事件放在最高层，到期前会重新挂载
+
+    struct Node {
+        int prev = -1;
+        int next = -1;
+        int slot = -1; //所在槽，-1表示不在时间轮中
+        int64_t expires = 0; //到期时间（毫秒），adjust只修改它
+        uint64_t tick = 0; //挂载时使用的到期格（expires可能晚于它，届时重新挂载）
+        TimeoutCallBack cb;
+    };
+
+    void Link_(int id, uint64_t tick);
+    void Unlink_(int id);
+    void Schedule_(int id, uint64_t minTick); //按节点的到期时间挂到对应的槽（不早于minTick）
+    void Cascade_(int level); //上层当前槽的节点下放到下层
+    void Expire_(); //处理第0层当前槽的节点
+    void Advance_(uint64_t target); //把时间轮推进到target格
+    uint64_t NextTick_() const; //下一个需要处理的格（有节点到期或有上层槽需要下放），没有节点时返回0
+    uint64_t ToTick_(int64_t ms) const { return static_cast<uint64_t>((ms + TICK_MS - 1) / TICK_MS); }
+
+    std::vector<Node> nodes_; //按id（fd）下标存放的节点，只增不减
+    int heads_[LEVELS * SLOTS]; //各槽链表头
+    uint64_t bitmap_[LEVELS]; //各层非空槽的位图，用于快速找到下一个非空槽
+    uint64_t current_; //当前所在格
+    int64_t nowMs_; //缓存的当前时间（毫秒）
+    size_t count_; //时间轮中的节点数
+};
+
+#endif
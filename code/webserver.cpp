@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <sys/socket.h>
 #include <fcntl.h>
+#include <algorithm>
 
 using namespace std;
 
@@ -14,9 +15,14 @@ WebServer::WebServer(
             int port, int trigMode, int timeoutMS, bool OptLinger,
             int sqlPort, const char* sqlUser, const  char* sqlPwd,
             const char* dbName, int connPoolNum, int threadNum,
-            bool openLog, int logLevel, int logQueSize):
-            port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS), isClose_(false),
-            timer_(new HeapTimer()), threadpool_(new ThreadPool(threadNum)), epoller_(new Epoller())
+            bool openLog, int logLevel, int logQueSize, int reactorNum, bool useIoUring,
+            const char* cpuAffinity, int logCpu, int memBudgetMB, int sendfileMinKB, int fileCacheMB,
+            const char* cacheControl, bool watchResources, int warmUpThreads,
+            int maxBodyKB, int spoolKB):
+            port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS),
+            memBudget_(memBudgetMB > 0 ? static_cast<size_t>(memBudgetMB) << 20 : 0), isClose_(false),
+            reusePort_(false), useIoUring_(useIoUring),
+            users_(new ConnSlab(ConnSlab::DefaultCapacity(MAX_FD)))
     {
     // 确定资源目录（优先使用编译期指定的 RESOURCE_DIR；其次根据运行目录智能回退）
     {
@@ -59,13 +65,50 @@ WebServer::WebServer(
     }
     HttpConn::userCount = 0; //初始化客户端连接计数
     HttpConn::srcDir = srcDir_; //给HttpConn类设置资源目录
+    //请求体：超过maxBodyKB回复413，超过spoolKB写入临时文件而不是留在读缓冲区
+    HttpRequest::maxBodySize = static_cast<size_t>(maxBodyKB > 0 ? maxBodyKB : 0) << 10;
+    HttpRequest::spoolSize = static_cast<size_t>(spoolKB > 0 ? spoolKB : 0) << 10;
+    //静态文件缓存：不小于sendfileMinKB的文件保持打开走sendfile，负数表示全部用mmap
+    FileCache::Instance()->Init(fileCacheMB, sendfileMinKB >= 0 ? static_cast<long>(sendfileMinKB) << 10 : -1);
+    //静态文件的Cache-Control: max-age按MIME类型配置
+    bool cacheControlOk = FileCache::Instance()->SetMaxAge(cacheControl ? cacheControl : "");
 
     //初始化数据库连接池（单例模式）
     SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
 
+    //确定事件循环数量：0表示每个CPU核心一个，1为经典的单Reactor模式
+    if(reactorNum <= 0) {
+        reactorNum = static_cast<int>(std::thread::hardware_concurrency());
+        if(reactorNum <= 0) { reactorNum = 1; }
+    }
+    reusePort_ = (reactorNum > 1);
+
+    //CPU绑定：事件循环依次使用前reactorNum个位置，工作线程接在后面
+    bool placementOk = placement_.Init(cpuAffinity, logCpu);
+    //多NUMA节点时缓冲区的块和静态文件缓存按节点分池，各线程使用自己所在节点的内存
+    int numaNodes = placement_.Enabled() && placement_.NodeCount() > 1 ? placement_.NodeCount() : 1;
+    Buffer::SetNumaNodes(numaNodes);
+    FileCache::Instance()->SetNumaNodes(numaNodes);
+    threadpool_.reset(new WorkStealPool(threadNum, [this, reactorNum](int i) {
+        CpuPlacement::PinSelf(placement_.CpuFor(reactorNum + i));
+    }));
+
     InitEventMode_(trigMode); //初始化事件触发模式（ET/LT）
-    if(!InitSocket_())  {
-        isClose_ = true; //初始化监听socket
+    for(int i = 0; i < reactorNum && !isClose_; i++) {
+        std::unique_ptr<Reactor> reactor(new Reactor());
+        reactor->id_ = i;
+        reactor->server_ = this;
+        reactor->timer_.reset(new TimeWheel());
+        reactor->epoller_.reset(new Epoller(1024, useIoUring_));
+        if(!InitSocket_(reactor.get())) {
+            isClose_ = true; //初始化监听socket
+        }
+        //唤醒用的eventfd，data.ptr为本循环的命令队列
+        reactor->wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(reactor->wakeFd_ < 0 || !reactor->epoller_->AddFd(reactor->wakeFd_, EPOLLIN, &reactor->mailbox_)) {
+            isClose_ = true;
+        }
+        reactors_.push_back(std::move(reactor));
     }
     //初始化日志系统
     if(openLog) {
@@ -74,20 +117,72 @@ WebServer::WebServer(
         else {
             LOG_INFO("========== Server init ==========");
             LOG_INFO("Port:%d, OpenLinger: %s", port_, OptLinger? "true":"false");
+            LOG_INFO("Reactor Mode: %s, EventLoop num: %d",
+                            (reusePort_ ? "multi (SO_REUSEPORT)" : "single"), (int)reactors_.size());
+            bool uring = !reactors_.empty() && reactors_[0]->epoller_->IsIoUring();
+            bool ringIo = uring && reactors_[0]->epoller_->RingIo();
+            LOG_INFO("IO Backend: %s", (ringIo ? "io_uring (provided-buffer recv, linked send)"
+                                       : uring ? "io_uring (poll)" : "epoll"));
+            if(useIoUring_ && !uring) {
+                LOG_WARN("io_uring not supported by running kernel, fall back to epoll");
+            }
             LOG_INFO("Listen Mode: %s, OpenConn Mode: %s",
                             (listenEvent_ & EPOLLET ? "ET": "LT"),
                             (connEvent_ & EPOLLET ? "ET": "LT"));
             LOG_INFO("LogSys level: %d", logLevel);
             LOG_INFO("srcDir: %s", HttpConn::srcDir);
             LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            LOG_INFO("ConnSlab capacity: %d", (int)users_->Capacity());
+            if(memBudget_ > 0) {
+                LOG_INFO("Connection memory budget: %d MB", memBudgetMB);
+            }
+            if(sendfileMinKB >= 0) {
+                LOG_INFO("Static file send: sendfile for files >= %d KB, mmap below", sendfileMinKB);
+            } else {
+                LOG_INFO("Static file send: mmap");
+            }
+            LOG_INFO("File cache budget: %d MB", fileCacheMB > 0 ? fileCacheMB : 0);
+            LOG_INFO("Request body limit: %d KB, spool to file above %d KB", maxBodyKB, spoolKB);
+            if(!cacheControlOk) {
+                LOG_WARN("Invalid cache control \"%s\", Cache-Control is not sent", cacheControl);
+            }
+            if(!placementOk) {
+                LOG_WARN("Invalid cpu affinity \"%s\", threads are not pinned", cpuAffinity ? cpuAffinity : "");
+            }
+            LogPlacement_(threadNum);
         }
     }
+    if(placement_.LogCpu() >= 0) {
+        Log::Instance()->PinWriter(placement_.LogCpu());
+    }
+
+    //资源目录监视：inotify通知到达时立即刷新缓存项，按间隔stat只作为兜底（漏掉事件时最多延迟这么久）
+    if(watchResources && srcDir_) {
+        watcher_.reset(new ResourceWatcher());
+        if(watcher_->Start(srcDir_)) {
+            LOG_INFO("Resource watcher: %d directories", (int)watcher_->WatchCount());
+            FileCache::Instance()->SetRevalidateMs(WATCHED_REVALIDATE_MS);
+        } else {
+            watcher_.reset();
+        }
+    }
+    //启动前预热：在开始接受连接之前把资源目录全部加载进缓存，0表示不预热
+    if(warmUpThreads > 0 && srcDir_) {
+        ResourceWatcher::WarmUp(srcDir_, warmUpThreads);
+    }
 }
 
 //析构函数
 WebServer::~WebServer() {
-    close(listenFd_);
     isClose_ = true;
+    for(auto& t : loopThreads_) {
+        if(t.joinable()) t.join();
+    }
+    watcher_.reset();
+    for(auto& reactor : reactors_) {
+        if(reactor->listenFd_ >= 0) close(reactor->listenFd_);
+        if(reactor->wakeFd_ >= 0) close(reactor->wakeFd_);
+    }
     free(srcDir_);
     SqlConnPool::Instance()->ClosePool();
 }
@@ -97,7 +192,7 @@ void WebServer::InitEventMode_(int trigMode) {
     //基础事件初始化
     //listenEvent_负责接收新连接，connEvent_负责与客户端收发数据
     listenEvent_ = EPOLLRDHUP; //监听 socket 的基础事件：检测到连接异常关闭
-    connEvent_ = EPOLLONESHOT | EPOLLRDHUP; //客户端连接的基础事件
+    connEvent_ = EPOLLRDHUP; //客户端连接的基础事件
     switch (trigMode)
     {
     case 0: //LT / LT
@@ -117,23 +212,85 @@ void WebServer::InitEventMode_(int trigMode) {
         connEvent_ |= EPOLLET;
         break;
     }
+    //ET模式：连接注册一次 EPOLLIN|EPOLLOUT 的持久关注，之后由状态机决定是否处理，不再反复epoll_ctl
+    //LT模式：持久关注可读/可写会导致处理期间事件反复触发，仍使用ONESHOT，状态变化时重新挂上
+#ifdef WEBSERVER_COROUTINE
+    //协程模式：连接事件由事件循环直接恢复协程，只支持持久关注的ET模式
+    connEvent_ |= EPOLLET;
+#endif
+    if(!(connEvent_ & EPOLLET)) {
+        connEvent_ |= EPOLLONESHOT;
+    }
     HttpConn::isET = (connEvent_ & EPOLLET);
 }
 
+void WebServer::AddStreamHandler(const std::string& path, const std::string& contentType,
+                                 StreamBody::Handler handler) {
+    HttpConn::AddStream(path, contentType, std::move(handler));
+}
+
 void WebServer::Start() {
+    if(isClose_) return;
+    LOG_INFO("========== Server start ==========");
+
+    //多Reactor模式：1号及以后的循环各自启动一个线程，0号循环运行在当前线程
+    for(size_t i = 1; i < reactors_.size(); i++) {
+        Reactor* reactor = reactors_[i].get();
+        loopThreads_.emplace_back([this, reactor]() { Loop_(reactor); });
+    }
+    Loop_(reactors_[0].get());
+
+    //0号循环退出（服务器关闭），等待其余循环结束
+    isClose_ = true;
+    for(auto& t : loopThreads_) {
+        if(t.joinable()) t.join();
+    }
+    loopThreads_.clear();
+}
+
+void WebServer::LogPlacement_(int threadNum) {
+    LOG_INFO("CPU placement: %s, %d cpus, %d NUMA nodes", placement_.PolicyName(),
+             placement_.CpuCount(), placement_.NodeCount());
+    if(placement_.Enabled()) {
+        for(size_t i = 0; i < reactors_.size(); i++) {
+            int cpu = placement_.CpuFor(static_cast<int>(i));
+            LOG_INFO("EventLoop[%d] -> cpu %d (node %d)", (int)i, cpu, placement_.NodeOf(cpu));
+        }
+        std::string workers;
+        for(int i = 0; i < threadNum; i++) {
+            int cpu = placement_.CpuFor(static_cast<int>(reactors_.size()) + i);
+            workers += (i ? "," : "") + std::to_string(cpu);
+        }
+        LOG_INFO("Workers -> cpus %s", workers.c_str());
+    }
+    if(Buffer::NumaNodes() > 1) {
+        LOG_INFO("Buffer slabs and file cache: per-node pools on %d NUMA nodes", Buffer::NumaNodes());
+    }
+    if(placement_.LogCpu() >= 0) {
+        LOG_INFO("Log writer -> cpu %d (node %d)", placement_.LogCpu(), placement_.NodeOf(placement_.LogCpu()));
+    }
+}
+
+void WebServer::Loop_(Reactor* reactor) {
     int timeMS = -1; //超时时间变量（传给 epoll_wait）
+    //绑定CPU（0号循环绑定的是调用Start()的线程）
+    CpuPlacement::PinSelf(placement_.CpuFor(reactor->id_));
+    TimeWheel* timer = reactor->timer_.get();
+    Epoller* epoller = reactor->epoller_.get();
 
-    if(!isClose_) LOG_INFO("========== Server start ==========");
+    LOG_INFO("EventLoop[%d] start, listenFd:%d", reactor->id_, reactor->listenFd_);
     
-    //服务器主循环
+    //事件循环主体
     while(!isClose_) {
         //步骤1：获取下一次超时的时间（由定时器决定）
         if(timeoutMS_ > 0) {
-            timeMS = timer_->GetNextTick(); //从堆定时器中获取最近的超时时间
+            timeMS = timer->GetNextTick(); //从时间轮中获取最近的超时时间
         }
 
         //步骤2：等待事件发生（阻塞在这里，直到有事件或超时）
-        int eventCnt = epoller_->Wait(timeMS);
+        int eventCnt = epoller->Wait(timeMS);
+        //本轮事件处理（刷新超时）使用同一个缓存时间，避免每个事件都读一次时钟
+        timer->UpdateNow();
 
         // 新增：处理 epoll_wait 错误
         if (eventCnt < 0) {
@@ -146,32 +303,42 @@ void WebServer::Start() {
         }
 
         //步骤3：遍历所有就绪事件，分发给对应逻辑处理
+        //注册时data.ptr存放的是对象指针：监听socket为所属Reactor，客户端连接为HttpConn
         for(int i = 0; i < eventCnt; i++) {
-            int fd = epoller_->GetEventFd(i); //获取触发事件的 fd
-            uint32_t events = epoller_->GetEvents(i); //获取事件类型
+            void* ptr = epoller->GetEventPtr(i);
+            uint32_t events = epoller->GetEvents(i); //获取事件类型
             //分支1：如果是监听socket的事件（新客户端连接）
-            if(fd == listenFd_) {
-                DealListen_();
+            if(ptr == reactor) {
+                DealListen_(reactor);
             }
-            //分支2：如果是连接关闭/错误事件（客户端断开或出错）
-            else if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-                assert(users_.count(fd) > 0); //确保该fd存在于客户端映射中
-                CloseConn_(&users_[fd]);
+            //分支2：工作线程的唤醒，清空eventfd计数（命令在本轮末尾统一处理）
+            else if(ptr == &reactor->mailbox_) {
+                uint64_t cnt;
+                while(read(reactor->wakeFd_, &cnt, sizeof(cnt)) > 0) {}
             }
-            //分支3：如果是可读事件（客户端发来了数据）
-            else if(events & EPOLLIN) {
-                assert(users_.count(fd) > 0);
-                DealRead_(&users_[fd]);
+            //分支3：客户端连接的事件，交给状态机处理
+            else {
+                DealEvent_(reactor, static_cast<HttpConn*>(ptr), events);
             }
-            //分支4：如果是可写事件（可以给客户端发数据了）
-            else if(events & EPOLLOUT) {
-                assert(users_.count(fd) > 0);
-                DealWrite_(&users_[fd]);
-            } else {
-                //未知事件，记录错误日志
-                LOG_ERROR("Unexpected event");
+        }
+
+        //步骤4：执行工作线程投递的命令
+        DrainMailbox_(reactor);
+
+        //io_uring发送链结束后，完成延迟的关闭
+        for(int fd; (fd = epoller->TakeClosable()) >= 0; ) {
+            HttpConn* client = users_->Get(fd);
+            epoller->DelFd(fd);
+            if(client) {
+                users_->Free(fd);
+                client->Close();
             }
         }
+
+        //步骤5：连接占用的内存超出预算时，淘汰最久没有活动的空闲连接
+        if(memBudget_ > 0 && MemUsage_() > memBudget_) {
+            EvictIdle_(reactor);
+        }
     }
 }
 
@@ -186,40 +353,182 @@ void WebServer::SendError_(int fd, const char*info) {
     close(fd);
 }
 
-void WebServer::CloseConn_(HttpConn* client) {
+void WebServer::CloseConn_(Reactor* reactor, HttpConn* client) {
     assert(client);
     int fd = client->GetFd();
     LOG_INFO("Client[%d] quit!", fd);
-    epoller_->DelFd(fd);
+    reactor->timer_->cancel(fd);
+    reactor->lru_.Remove(fd);
+    //发送链还在使用fd和发送队列：先shutdown让阻塞的发送出错返回，发送链结束后由事件循环关闭
+    if(reactor->epoller_->CloseLater(fd)) {
+        shutdown(fd, SHUT_RDWR);
+        return;
+    }
+    reactor->epoller_->DelFd(fd);
+    //先释放槽位再关闭fd：fd关闭前不会被其他循环accept到，槽位不会被抢占
+    users_->Free(fd);
     client->Close();
-    // 连接关闭后，从映射中移除，避免长期膨胀
-    users_.erase(fd);
 }
 
-void WebServer::AddClient_(int fd, sockaddr_in addr) {
+size_t WebServer::MemUsage_() const {
+    return Buffer::HeldBytes() + static_cast<size_t>(HttpConn::userCount.load(std::memory_order_relaxed)) * sizeof(HttpConn);
+}
+
+//从最久没有活动的连接开始，关闭空闲连接直到降到预算的90%（留出余量，避免在预算边缘反复淘汰）
+//正在处理请求的连接跳过；每个事件循环只淘汰自己的连接
+void WebServer::EvictIdle_(Reactor* reactor) {
+    size_t target = memBudget_ / 10 * 9;
+    int evicted = 0;
+    int fd = reactor->lru_.Front();
+    for(int scanned = 0; fd >= 0 && scanned < EVICT_SCAN && MemUsage_() > target; scanned++) {
+        int next = reactor->lru_.Next(fd);
+        HttpConn* client = users_->Get(fd);
+        if(client && client->IsIdle()) {
+#ifdef WEBSERVER_COROUTINE
+            DealEventCo_(reactor, client, EPOLLHUP); //协程恢复后退出并关闭连接
+#else
+            uint32_t idle = HttpConn::CONN_IDLE;
+            if(client->State().compare_exchange_strong(idle, HttpConn::CONN_CLOSED, std::memory_order_acq_rel)) {
+                CloseConn_(reactor, client);
+            }
+#endif
+            evicted++;
+        }
+        fd = next;
+    }
+    if(evicted > 0) {
+        LOG_WARN("EventLoop[%d] memory over budget, evicted %d idle connections", reactor->id_, evicted);
+    }
+}
+
+void WebServer::Post_(Reactor* reactor, HttpConn* client, int op, uint32_t events) {
+    //只在持有连接期间调用：此时代数不会变化
+    int fd = client->GetFd();
+    Post_(reactor, fd, users_->Gen(fd), op, events);
+}
+
+//(fd, gen)由调用方在交还连接之前取好：交还之后连接可能被关闭、fd被复用甚至对象被释放
+void WebServer::Post_(Reactor* reactor, int fd, uint32_t gen, int op, uint32_t events) {
+    const ConnCmd cmd = {fd, gen, op, events};
+    while(!reactor->mailbox_.Push(cmd)) {
+        //命令队列已满：确保事件循环已被唤醒去取命令，让出CPU后重试
+        Wake_(reactor);
+        std::this_thread::yield();
+    }
+    Wake_(reactor);
+}
+
+void WebServer::Wake_(Reactor* reactor) {
+    //合并唤醒：事件循环清除标记之前的投递共用一次eventfd写入
+    if(!reactor->wakePending_.exchange(true, std::memory_order_acq_rel)) {
+        uint64_t one = 1;
+        if(write(reactor->wakeFd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            LOG_ERROR("EventLoop[%d] wakeup failed! errno: %d", reactor->id_, errno);
+        }
+    }
+}
+
+void WebServer::DrainMailbox_(Reactor* reactor) {
+    //先清除标记再取命令：之后的投递会重新唤醒，不会遗漏
+    reactor->wakePending_.store(false, std::memory_order_seq_cst);
+    std::vector<ConnCmd>& batch = reactor->batch_;
+    ConnCmd cmd;
+    while(reactor->mailbox_.Pop(cmd)) {
+        batch.push_back(cmd);
+    }
+    if(batch.empty()) {
+        return;
+    }
+    //按连接归并（稳定排序保持同一连接内命令的先后顺序）
+    std::stable_sort(batch.begin(), batch.end(), [](const ConnCmd& a, const ConnCmd& b) {
+        return a.fd != b.fd ? a.fd < b.fd : a.gen < b.gen;
+    });
+    for(size_t i = 0, j = 0; i < batch.size(); i = j) {
+        bool closeConn = false, extend = false, rearm = false, resume = false;
+        uint32_t events = 0;
+        for(j = i; j < batch.size() && batch[j].fd == batch[i].fd && batch[j].gen == batch[i].gen; j++) {
+            if(batch[j].op == CMD_CLOSE) {
+                closeConn = true;
+            } else if(batch[j].op == CMD_REARM) {
+                rearm = true;
+                events = batch[j].events; //只保留最后一次
+            } else if(batch[j].op == CMD_RESUME) {
+                resume = true;
+            } else {
+                extend = true;
+            }
+        }
+        HttpConn* client = users_->Get(batch[i].fd, batch[i].gen);
+        if(!client) {
+            continue;
+        }
+        //关闭优先，其余命令无需再执行
+        if(closeConn) {
+            CloseConn_(reactor, client);
+            continue;
+        }
+        if(rearm) {
+            reactor->epoller_->ModFd(batch[i].fd, events, client);
+        }
+        if(extend) {
+            ExtentTime_(reactor, client);
+        }
+#ifdef WEBSERVER_COROUTINE
+        if(resume) {
+            ResumeCo_(reactor, client);
+        }
+#else
+        (void)resume; //只有协程模式会投递CMD_RESUME
+#endif
+    }
+    batch.clear();
+}
+
+void WebServer::AddClient_(Reactor* reactor, int fd, sockaddr_in addr) {
     assert(fd > 0);
-    //初始化该 fd 对应的 HttpConn 对象
-    users_[fd].Init(fd, addr);
-    //如果设置了超时时间，给这个客户端添加定时器（仅捕获fd，避免悬垂指针）
+    //从连接表中取出该 fd 对应的 HttpConn 对象并初始化
+    uint32_t gen = 0;
+    HttpConn* client = users_->Alloc(fd, &gen);
+    if(!client) {
+        SendError_(fd, "Server busy!");
+        LOG_WARN("Client fd:%d exceeds ConnSlab capacity!", fd);
+        return;
+    }
+    client->Init(fd, addr);
+    //如果设置了超时时间，给这个客户端添加定时器（捕获fd和代数，fd被复用后旧定时器不会误关新连接）
     if(timeoutMS_ > 0) {
         int cfd = fd;
-        timer_->add(cfd, timeoutMS_, [this, cfd]() {
-            auto it = users_.find(cfd);
-            if (it != users_.end()) {
-                CloseConn_(&it->second);
-            } else {
-                epoller_->DelFd(cfd);
+        reactor->timer_->add(cfd, timeoutMS_, [this, reactor, cfd, gen]() {
+            HttpConn* conn = users_->Get(cfd, gen);
+            if (conn) {
+                //超时按对端挂断处理：若工作线程正在处理，由其处理完后关闭
+                DealEvent_(reactor, conn, EPOLLHUP);
             }
         });
     }
     // 先设置非阻塞，再注册到 Epoller（避免短暂阻塞风险）
-    SetFdNonblock(fd);
-    epoller_->AddFd(fd, EPOLLIN | connEvent_);
-    LOG_INFO("Client[%d] in!", users_[fd].GetFd());
+    // ET模式下一次性注册可读+可写，之后不再修改；data.ptr直接指向连接对象
+    // io_uring收发的连接保持阻塞：发送链中的splice在内核工作线程中执行，非阻塞socket会直接返回EAGAIN
+    uint32_t interest = (connEvent_ & EPOLLET) ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    if(reactor->epoller_->RingIo()) {
+        client->UseRing(reactor->epoller_.get());
+    } else {
+        SetFdNonblock(fd);
+    }
+    reactor->epoller_->AddConnFd(fd, interest | connEvent_, client);
+    if(memBudget_ > 0) {
+        reactor->lru_.Touch(fd);
+    }
+    LOG_INFO("Client[%d] in! EventLoop[%d]", fd, reactor->id_);
+#ifdef WEBSERVER_COROUTINE
+    //创建连接的协程并立即运行到第一次等待
+    client->Co().handle = Serve_(reactor, client).Release();
+    ResumeCo_(reactor, client);
+#endif
 }
 
 //处理监听套接字，主要逻辑是accept新的套接字，并加入timer和epoller中
-void WebServer::DealListen_() {
+void WebServer::DealListen_(Reactor* reactor) {
     //定义客户端地址结构体（用于存储新连接的客户端 IP 和端口）
     struct sockaddr_in addr;
     socklen_t len = sizeof(addr);
@@ -227,7 +536,8 @@ void WebServer::DealListen_() {
     do {
         //调用accept()接收新连接，获取客户端socket的fd和地址信息
         //accept()为系统调用，
-        int fd = accept(listenFd_, (struct sockaddr *)&addr, &len);
+        //epoll后端直接accept，io_uring后端取出multishot accept已经接收的连接
+        int fd = reactor->epoller_->Accept(reactor->listenFd_, (struct sockaddr *)&addr, &len);
         if(fd <= 0) {
             if (errno != EAGAIN && errno != EWOULDBLOCK) {
                 LOG_ERROR("accept error! errno: %d", errno);
@@ -240,33 +550,145 @@ void WebServer::DealListen_() {
             LOG_WARN("Clients is full!");
             return;
         }
-        AddClient_(fd, addr);
+        AddClient_(reactor, fd, addr);
     } while(listenEvent_ & EPOLLET);
 }
 
+//连接状态机（事件循环一侧）：
+//空闲/读等待状态收到可读、写等待状态收到可写时认领连接（置为PROCESSING）并投递任务；
+//连接正在被工作线程处理时，只把事件记在状态字的高位，由工作线程处理完后接着处理；
+//其余组合（例如读等待时的可写边沿）无需处理，直接忽略
+void WebServer::DealEvent_(Reactor* reactor, HttpConn* client, uint32_t events) {
+    assert(client);
+    if(memBudget_ > 0) {
+        reactor->lru_.Touch(client->GetFd()); //有活动，移到最新
+    }
+#ifdef WEBSERVER_COROUTINE
+    DealEventCo_(reactor, client, events);
+    return;
+#endif
+    uint32_t pend = 0;
+    if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) pend |= HttpConn::PENDING_CLOSE;
+    if(events & EPOLLIN) pend |= HttpConn::PENDING_IN;
+    if(events & EPOLLOUT) pend |= HttpConn::PENDING_OUT;
+
+    std::atomic<uint32_t>& state = client->State();
+    uint32_t cur = state.load(std::memory_order_acquire);
+    while(true) {
+        uint32_t st = cur & HttpConn::STATE_MASK;
+        uint32_t next = cur;
+        int action = ACT_NONE;
+        if(st == HttpConn::CONN_CLOSED) {
+            return; //迟到的事件（连接已关闭）
+        } else if(st == HttpConn::CONN_PROCESSING) {
+            next = cur | pend; //工作线程处理完后会检查
+        } else if(pend & HttpConn::PENDING_CLOSE) {
+            next = HttpConn::CONN_CLOSED;
+            action = ACT_CLOSE;
+        } else if(st == HttpConn::CONN_WRITING && (pend & HttpConn::PENDING_OUT)) {
+            next = HttpConn::CONN_PROCESSING | (cur & HttpConn::PENDING_IN);
+            action = ACT_WRITE;
+        } else if(st == HttpConn::CONN_WRITING && (pend & HttpConn::PENDING_IN)) {
+            next = cur | HttpConn::PENDING_IN; //响应发完后再读下一个请求
+        } else if(st != HttpConn::CONN_WRITING && (pend & HttpConn::PENDING_IN)) {
+            next = HttpConn::CONN_PROCESSING;
+            action = ACT_READ;
+        }
+        if(next == cur) {
+            return;
+        }
+        if(state.compare_exchange_weak(cur, next, std::memory_order_acq_rel)) {
+            if(action == ACT_CLOSE) {
+                CloseConn_(reactor, client);
+            } else if(action == ACT_READ) {
+                DealRead_(reactor, client);
+            } else if(action == ACT_WRITE) {
+                DealWrite_(reactor, client);
+            }
+            return;
+        }
+    }
+}
+
 //这两是处理“客户端读写事件”的调度函数
-void WebServer::DealRead_(HttpConn* client) {
+void WebServer::DealRead_(Reactor* reactor, HttpConn* client) {
     assert(client);
-    ExtentTime_(client); //延长该客户端的超时时间（有活动，说明没闲置）
-    //将“读事件的实际处理逻辑”封装 成任务，交给线程池执行
-    threadpool_->AddTask(std::bind(&WebServer::OnRead_, this, client)); //这是一个右值，bind将参数和函数绑定
+    ExtentTime_(reactor, client); //延长该客户端的超时时间（有活动，说明没闲置）
+    //将“读事件的实际处理逻辑”交给线程池执行
+    Dispatch_(reactor, client, ACT_READ);
 }
 
-void WebServer::DealWrite_(HttpConn* client) {
+void WebServer::DealWrite_(Reactor* reactor, HttpConn* client) {
     assert(client);
-    ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnWrite_, this, client));
+    ExtentTime_(reactor, client);
+    Dispatch_(reactor, client, ACT_WRITE);
+}
+
+//投递连接自带的任务节点（不分配内存）；任务记录(fd, 代数)，执行时连接已关闭或fd被复用则丢弃
+void WebServer::Dispatch_(Reactor* reactor, HttpConn* client, int action) {
+    HttpConn::ReadyTask& task = client->Ready();
+    task.run_ = &WebServer::RunTask_;
+    task.owner = reactor;
+    task.gen = users_->Gen(client->GetFd());
+    task.action = action;
+    threadpool_->AddTask(&task);
+}
+
+void WebServer::RunTask_(TaskNode* node) {
+    HttpConn::ReadyTask* task = static_cast<HttpConn::ReadyTask*>(node);
+    Reactor* reactor = static_cast<Reactor*>(task->owner);
+    int fd = task->conn->GetFd();
+    if(task->action == ACT_READ) {
+        reactor->server_->OnRead_(reactor, fd, task->gen);
+    } else {
+        reactor->server_->OnWrite_(reactor, fd, task->gen);
+    }
 }
 
 //延长客户端连接的超时时间
-void WebServer::ExtentTime_(HttpConn* client) {
+void WebServer::ExtentTime_(Reactor* reactor, HttpConn* client) {
     assert(client);
     //调用定时器的adjust方法，把它的超时时间重新设置为 timeoutMS_ 毫秒
-    if(timeoutMS_ > 0) { timer_->adjust(client->GetFd(), timeoutMS_); }
+    if(timeoutMS_ > 0) { reactor->timer_->adjust(client->GetFd(), timeoutMS_); }
 }
 
-void WebServer::OnRead_(HttpConn* client) {
-    assert(client);
+void WebServer::OnRead_(Reactor* reactor, int fd, uint32_t gen) {
+    HttpConn* client = users_->Get(fd, gen);
+    if(!client) {
+        return; //过期任务：连接已关闭或fd已被复用
+    }
+    OnProcess(reactor, client, gen, ACT_READ);
+}
+
+void WebServer::OnWrite_(Reactor* reactor, int fd, uint32_t gen) {
+    HttpConn* client = users_->Get(fd, gen);
+    if(!client) {
+        return; //过期任务：连接已关闭或fd已被复用
+    }
+    OnProcess(reactor, client, gen, ACT_WRITE);
+}
+
+//工作线程持有连接（PROCESSING）期间一直处理，直到需要等待新事件或连接关闭
+//工作线程不直接修改Epoller、定时器和连接表，需要时向所属事件循环投递命令
+//Finish_交还连接（ACT_NONE/ACT_CLOSE）之后不能再访问client，命令使用事先取好的(fd, gen)
+void WebServer::OnProcess(Reactor* reactor, HttpConn* client, uint32_t gen, int action) {
+    const int fd = client->GetFd();
+    while(action == ACT_READ || action == ACT_WRITE) {
+        uint32_t next = (action == ACT_READ) ? DoRead_(reactor, client) : DoWrite_(reactor, client);
+        action = Finish_(client, next);
+        if(action == ACT_NONE) {
+            Rearm_(reactor, fd, gen, next);
+        } else if(action != ACT_CLOSE && timeoutMS_ > 0) {
+            //直接处理了处理期间到达的事件（没有经过事件循环），由事件循环顺延超时
+            Post_(reactor, fd, gen, CMD_EXTEND);
+        }
+    }
+    if(action == ACT_CLOSE) {
+        Post_(reactor, fd, gen, CMD_CLOSE);
+    }
+}
+
+uint32_t WebServer::DoRead_(Reactor* reactor, HttpConn* client) {
     int ret = -1; //取的字节数
     int readErrno = 0; //错误码（用于区分正常和异常情况）
 
@@ -275,54 +697,230 @@ void WebServer::OnRead_(HttpConn* client) {
 
     if(ret <= 0 && readErrno != EAGAIN) {
         //情况1：读取失败且不是“暂时无数据”（真正的错误）
-        CloseConn_(client);
-        return;
+        return HttpConn::CONN_CLOSED;
     }
     //情况2：读取成功（或暂时无数据但连接正常），进入请求处理阶段
-    OnProcess(client);
-}
-
-void WebServer::OnProcess(HttpConn* client) {
-    if(client->process()) { 
-        //情况1：请求解析完成（且生成了响应），需要切换到“监听可写事件”
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);  
-    } else {
-        //情况2：请求未解析完成（需要更多数据），继续监听“可读事件”
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
+    if(client->process()) {
+        //请求解析完成（且生成了响应）：发送缓冲区通常有空间，直接发送，不必先等可写事件
+        return DoWrite_(reactor, client);
     }
+    //请求未解析完成（需要更多数据），继续等待可读
+    return HttpConn::CONN_READING;
 }
 
-void WebServer::OnWrite_(HttpConn* client) {
-    assert(client);
+uint32_t WebServer::DoWrite_(Reactor* reactor, HttpConn* client) {
     int ret = -1; //发送的字节数
     int writeErrno = 0; //错误码（区分正常和异常情况）
 
-    //调用 HttpConn 的 write 方法，将写缓冲区的数据发送给客户端
-    ret = client->write(&writeErrno);
+    while(true) {
+        //调用 HttpConn 的 write 方法，按顺序发送队列中的响应
+        ret = client->write(&writeErrno);
 
-    //情况1：所有数据都已发送完成（写缓冲区为空）
-    if(client->ToWriteBytes() == 0) {
-        //如果是长连接（Connection: keep-alive）
-        if(client->IsKeepAlive()) {
-            //调整Epoll 监控事件为“可读”，等待客户端的下一次请求
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
-            return;
+        //情况1：数据未发完，但错误是“暂时无法发送”（EAGAIN），或LT模式下本轮只发了一部分，等待可写事件再试
+        if(client->ToWriteBytes() > 0) {
+            if(ret > 0 || (ret < 0 && writeErrno == EAGAIN)) {
+                return HttpConn::CONN_WRITING;
+            }
+            return HttpConn::CONN_CLOSED; //发送失败
+        }
+        //情况2：所有数据都已发送完成
+        CountRequest_(reactor, client->TakeResponses());
+        if(!client->IsKeepAlive()) {
+            return HttpConn::CONN_CLOSED; //短连接：关闭连接
+        }
+        //流水线：读缓冲区中还有请求（超过一批的部分），接着处理，不会再有可读事件通知它们
+        if(!client->HasInput() || !client->process()) {
+            break;
         }
     }
-    //情况2：数据未发完，但错误是“暂时无法发送”（EAGAIN）
-    else if(ret < 0) {
-        if(writeErrno == EAGAIN) {
-            //调整 Epoll 继续监控“可写事件”，等待下次能发送时再试
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
-            return;
+    if(client->HasInput()) {
+        return HttpConn::CONN_READING; //剩下的是不完整的请求，等待更多数据
+    }
+    //长连接（Connection: keep-alive），等待客户端的下一次请求
+    client->ReleaseBuffers(); //等待下一个请求期间不占用缓冲区
+    return HttpConn::CONN_IDLE;
+}
+
+void WebServer::CountRequest_(Reactor* reactor, int count) {
+    uint64_t n = reactor->requests_.fetch_add(count, std::memory_order_relaxed) + count;
+    if(n / 10000 != (n - count) / 10000) {
+        uint64_t ctl = reactor->epoller_->CtlCount();
+        LOG_INFO("EventLoop[%d] requests:%llu, epoll_ctl:%llu, epoll_ctl per request:%.3f",
+                 reactor->id_, (unsigned long long)n, (unsigned long long)ctl, (double)ctl / n);
+    }
+}
+
+//连接状态机（工作线程一侧）：提交处理后的下一个状态
+//处理期间若到达了与下一个状态相关的事件，则不交还连接，直接返回下一步动作
+int WebServer::Finish_(HttpConn* client, uint32_t next) {
+    std::atomic<uint32_t>& state = client->State();
+    uint32_t cur = state.load(std::memory_order_acquire);
+    //ET模式下读到上限后停下的数据不会再有可读事件，视同处理期间到达了可读事件
+    uint32_t more = client->MoreToRead() ? HttpConn::PENDING_IN : 0;
+    while(true) {
+        uint32_t pend = (cur & ~HttpConn::STATE_MASK) | more;
+        uint32_t want;
+        int action;
+        if(next == HttpConn::CONN_CLOSED || (pend & HttpConn::PENDING_CLOSE)) {
+            want = HttpConn::CONN_CLOSED;
+            action = ACT_CLOSE;
+        } else if(next == HttpConn::CONN_WRITING) {
+            if(pend & HttpConn::PENDING_OUT) {
+                want = HttpConn::CONN_PROCESSING | (pend & HttpConn::PENDING_IN);
+                action = ACT_WRITE;
+            } else {
+                want = next | (pend & HttpConn::PENDING_IN); //可读事件留到响应发完后处理
+                action = ACT_NONE;
+            }
+        } else if(pend & HttpConn::PENDING_IN) {
+            want = HttpConn::CONN_PROCESSING;
+            action = ACT_READ;
+        } else {
+            want = next;
+            action = ACT_NONE;
+        }
+        if(state.compare_exchange_weak(cur, want, std::memory_order_acq_rel)) {
+            return action;
+        }
+    }
+}
+
+//ET模式的持久关注无需任何操作；LT模式使用ONESHOT，需要按新状态重新挂上
+//注意必须在状态提交之后再挂上，保证事件循环收到事件时看到的是新状态
+void WebServer::Rearm_(Reactor* reactor, int fd, uint32_t gen, uint32_t state) {
+    if(!(connEvent_ & EPOLLONESHOT)) {
+        return;
+    }
+    uint32_t interest = (state == HttpConn::CONN_WRITING) ? EPOLLOUT : EPOLLIN;
+    Post_(reactor, fd, gen, CMD_REARM, connEvent_ | interest);
+}
+
+#ifdef WEBSERVER_COROUTINE
+//协程模式的连接处理流程：读 -> 解析 -> 发送，循环处理长连接上的请求
+//除访问数据库的请求外全部在事件循环线程上完成，没有线程切换
+ConnCoroutine WebServer::Serve_(Reactor* reactor, HttpConn* client) {
+    while(true) {
+        int err = 0;
+        ssize_t ret = client->read(&err);
+        if(ret <= 0 && err != EAGAIN) {
+            break; //对端关闭或读出错
+        }
+        bool done;
+        if(client->HasBlockingWork()) {
+            //登录/注册需要访问数据库：到线程池中解析并生成响应，再回到事件循环发送
+            co_await ToPool{this, client};
+            done = client->process();
+            co_await ToReactor{this, reactor, client};
+            if(client->Co().closing) {
+                break;
+            }
+        } else {
+            done = client->process();
+        }
+        if(!done) {
+            if(client->MoreToRead()) {
+                continue; //读到上限后停下的，socket中还有数据
+            }
+            //请求还没收完，等待更多数据；读缓冲区为空（空闲长连接）时先归还缓冲区
+            client->ReleaseBuffers();
+            bool ok = co_await IoAwait{client, HttpConn::PENDING_IN};
+            if(!ok) {
+                break;
+            }
+            continue;
+        }
+        bool alive = true;
+        while(true) {
+            ret = client->write(&err);
+            if(client->ToWriteBytes() == 0) {
+                CountRequest_(reactor, client->TakeResponses());
+                break;
+            }
+            if(ret > 0 || (ret < 0 && err == EAGAIN)) {
+                //发送缓冲区已满（或LT模式下本轮只发了一部分），等待可写
+                alive = co_await IoAwait{client, HttpConn::PENDING_OUT};
+                if(alive) {
+                    continue;
+                }
+            }
+            alive = false;
+            break;
+        }
+        if(!alive || !client->IsKeepAlive()) {
+            break;
+        }
+        if(client->HasInput() || client->MoreToRead()) {
+            continue; //流水线上还有请求：先处理已收到的，read遇到EAGAIN直接返回
+        }
+    }
+}
+
+void WebServer::DealEventCo_(Reactor* reactor, HttpConn* client, uint32_t events) {
+    HttpConn::CoState& co = client->Co();
+    if(!co.handle) {
+        return;
+    }
+    if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        co.closing = true;
+    }
+    uint32_t pend = 0;
+    if(events & EPOLLIN) pend |= HttpConn::PENDING_IN;
+    if(events & EPOLLOUT) pend |= HttpConn::PENDING_OUT;
+    if(co.waiting && (co.closing || (co.waiting & pend))) {
+        if(!co.closing) {
+            ExtentTime_(reactor, client);
         }
+        ResumeCo_(reactor, client);
+    } else {
+        co.pending |= pend; //协程正在线程池中，或等待的是另一种事件
+    }
+}
+
+void WebServer::ResumeCo_(Reactor* reactor, HttpConn* client) {
+    HttpConn::CoState& co = client->Co();
+    std::coroutine_handle<> h = co.handle;
+    h.resume();
+    if(h.done()) {
+        h.destroy();
+        co.handle = nullptr;
+        CloseConn_(reactor, client);
+    }
+}
+
+void WebServer::ResumeTask_(TaskNode* node) {
+    HttpConn::ReadyTask* task = static_cast<HttpConn::ReadyTask*>(node);
+    std::coroutine_handle<>::from_address(task->owner).resume();
+}
+
+bool WebServer::IoAwait::await_ready() {
+    HttpConn::CoState& co = client->Co();
+    if(co.closing) {
+        return true;
     }
-    //其他情况（数据发送失败/短连接）：关闭连接
-    CloseConn_(client);
+    if(co.pending & want) {
+        co.pending &= ~want; //等待之前事件已经到达
+        return true;
+    }
+    return false;
+}
+
+bool WebServer::IoAwait::await_resume() {
+    HttpConn::CoState& co = client->Co();
+    co.waiting = 0;
+    return !co.closing;
 }
 
+void WebServer::ToPool::await_suspend(std::coroutine_handle<> h) {
+    //复用连接的任务节点，owner存放协程句柄
+    HttpConn::ReadyTask& task = client->Ready();
+    task.run_ = &WebServer::ResumeTask_;
+    task.owner = h.address();
+    server->threadpool_->AddTask(&task);
+}
+#endif
+
 //创建socket的核心函数
-bool WebServer::InitSocket_() {
+bool WebServer::InitSocket_(Reactor* reactor) {
     int ret;
     struct sockaddr_in addr;
     //端口合法性检查
@@ -345,15 +943,15 @@ bool WebServer::InitSocket_() {
     }
 
     //创建监听socket（TCP 类型）
-    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if(listenFd_ < 0) {
+    reactor->listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if(reactor->listenFd_ < 0) {
         LOG_ERROR("Create socket error!");
         return false;
     }
     //设置 SO_LINGER 选项
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
+    ret = setsockopt(reactor->listenFd_, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
     if(ret < 0) {
-        close(listenFd_);
+        close(reactor->listenFd_);
         LOG_ERROR("Init linger error!");
         return false;
     }
@@ -362,40 +960,51 @@ bool WebServer::InitSocket_() {
     //允许端口复用（SO_REUSEADDR选项）
     //SO_REUSEADDR作用：允许服务器重启时立即复用同一端口
     int optval = 1;
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval, sizeof(int));
+    ret = setsockopt(reactor->listenFd_, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval, sizeof(int));
     if(ret == -1) {
         LOG_ERROR("set socket setsockopt error !");
-        close(listenFd_);
+        close(reactor->listenFd_);
         return false;
     }
 
+    //多Reactor模式：允许多个监听socket绑定同一端口（SO_REUSEPORT选项）
+    //内核按连接四元组哈希把新连接分摊到各个监听socket，各事件循环互不争抢accept
+    if(reusePort_) {
+        ret = setsockopt(reactor->listenFd_, SOL_SOCKET, SO_REUSEPORT, (const void*)&optval, sizeof(int));
+        if(ret == -1) {
+            LOG_ERROR("set SO_REUSEPORT error !");
+            close(reactor->listenFd_);
+            return false;
+        }
+    }
+
     //绑定端口（bind）
-    //将创建的listenFd_与前面配置的地址结构体（IP+端口）绑定，使socket与特定端口关联
-    ret = bind(listenFd_, (struct sockaddr *)&addr, sizeof(addr));
+    //将创建的reactor->listenFd_与前面配置的地址结构体（IP+端口）绑定，使socket与特定端口关联
+    ret = bind(reactor->listenFd_, (struct sockaddr *)&addr, sizeof(addr));
     if(ret < 0) {
         LOG_ERROR("Bind Port:%d error!", port_);
-        close(listenFd_);
+        close(reactor->listenFd_);
         return false;
     }
 
     //开始监听
-    ret = listen(listenFd_, 6); //第二个参数是“连接请求队列”的最大长度
+    ret = listen(reactor->listenFd_, 6); //第二个参数是“连接请求队列”的最大长度
     if(ret < 0) {
         LOG_ERROR("Listen port:%d error!", port_);
-        close(listenFd_);
+        close(reactor->listenFd_);
         return false;
     }
 
     //将监听socket注册到epoll
-    ret = epoller_->AddFd(listenFd_,  listenEvent_ | EPOLLIN);
+    ret = reactor->epoller_->AddListenFd(reactor->listenFd_,  listenEvent_ | EPOLLIN, reactor);
     if(!ret) {
         LOG_ERROR("Add listen error!");
-        close(listenFd_);
+        close(reactor->listenFd_);
         return false;
     }
 
     //设置监听socket为非阻塞模式
-    SetFdNonblock(listenFd_);   
+    SetFdNonblock(reactor->listenFd_);   
     LOG_INFO("Server port:%d", port_);
     return true;
 }
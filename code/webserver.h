@@ -9,62 +9,180 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/eventfd.h>
 #include <memory>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 #include "epoller.h"
-#include "heaptimer.h"
+#include "timewheel.h"
 #include "sqlconnpool.h"
-#include "threadpool.h"
+#include "workstealpool.h"
 #include "httpconn.h"
+#include "connslab.h"
+#include "cpuplacement.h"
+#include "mpscqueue.h"
+#include "lrulist.h"
+#include "resourcewatcher.h"
 
 class WebServer {
 public:
     WebServer(int port, int trigMode, int timeoutMS, bool OptLinger,
             int sqlPort, const char* sqlUser, const char* sqlPwd,
             const char* dbName, int connPoolNum, int threadNum,
-            bool openLog, int logLevel, int logQueSize);
+            bool openLog, int logLevel, int logQueSize,
+            int reactorNum = 1, bool useIoUring = false,
+            const char* cpuAffinity = "none", int logCpu = -1,
+            int memBudgetMB = 0, int sendfileMinKB = 16, int fileCacheMB = 64,
+            const char* cacheControl = "text/html=0,*=3600",
+            bool watchResources = true, int warmUpThreads = 0,
+            int maxBodyKB = 1024, int spoolKB = 64);
     ~WebServer();
     void Start();
+    //在path上注册流式响应（Transfer-Encoding: chunked，见StreamBody），需在Start()之前调用
+    void AddStreamHandler(const std::string& path, const std::string& contentType, StreamBody::Handler handler);
 
 private:
+    //事件循环（Reactor）：每个循环拥有自己的监听socket、Epoller和定时器，只处理自己accept的连接
+    //单Reactor模式下只有一个循环，运行在调用Start()的线程上
+    //多Reactor模式下每个循环独占一个线程，监听socket通过SO_REUSEPORT绑定同一端口，由内核分摊新连接
+    //工作线程发给事件循环的命令：Epoller、定时器和连接表只由事件循环线程修改
+    enum CONN_CMD {
+        CMD_REARM, //重新挂上关注事件（LT/ONESHOT模式）
+        CMD_CLOSE, //关闭连接
+        CMD_EXTEND, //延长超时时间
+        CMD_RESUME, //在事件循环上恢复连接的协程（协程模式）
+    };
+    struct ConnCmd {
+        int fd;
+        uint32_t gen; //连接代数，过期命令直接丢弃
+        int op;
+        uint32_t events; //CMD_REARM的关注事件
+    };
+
+    struct Reactor {
+        int id_; //循环编号（0号循环运行在调用Start()的线程上）
+        WebServer* server_ = nullptr; //所属服务器（工作线程任务通过它回到成员函数）
+        int listenFd_ = -1; //本循环的监听socket
+        int wakeFd_ = -1; //eventfd，工作线程投递命令后唤醒事件循环
+        std::unique_ptr<TimeWheel> timer_; //本循环的定时器（管理连接的空闲超时）
+        std::unique_ptr<Epoller> epoller_; //本循环的IO多路复用器
+        std::atomic<uint64_t> requests_{0}; //本循环已完成的请求数（统计每个请求的epoll_ctl次数）
+        MpscQueue<ConnCmd> mailbox_{MAILBOX_CAPACITY}; //工作线程 -> 事件循环的命令队列
+        std::atomic<bool> wakePending_{false}; //已有唤醒在途，其余投递者无需再写eventfd
+        std::vector<ConnCmd> batch_; //每轮循环取出的命令（复用内存）
+        LruList lru_; //本循环的连接按最近活动排序（开启内存预算时维护）
+    };
+
+    //工作线程处理完一个阶段后的下一步动作
+    enum CONN_ACTION {
+        ACT_NONE, //交还事件循环，等待下一次事件
+        ACT_READ, //继续读取并处理请求
+        ACT_WRITE, //继续发送响应
+        ACT_CLOSE, //关闭连接
+    };
+
     //初始化相关
-    bool InitSocket_(); //初始化监听socket（创建、绑定、监听、设置非阻塞）
+    bool InitSocket_(Reactor* reactor); //初始化监听socket（创建、绑定、监听、设置非阻塞）
     void InitEventMode_(int trigMode); //初始化事件触发模式（ET/LT），设置listenEvent_和connEvent_
-    void AddClient_(int fd, sockaddr_in addr); //添加新客户端连接（初始化 HttpConn、注册到 Epoller 等）
+    void AddClient_(Reactor* reactor, int fd, sockaddr_in addr); //添加新客户端连接（初始化 HttpConn、注册到 Epoller 等）
+
+    //事件循环主体（单Reactor和多Reactor模式共用）
+    void Loop_(Reactor* reactor);
     
     //事件处理相关
-    void DealListen_(); //处理监听socket的事件（新客户端连接请求）
-    void DealWrite_(HttpConn* client); //处理客户端的可写事件（发送响应）
-    void DealRead_(HttpConn* client); //处理客户端的可读事件（读取请求）
+    void DealListen_(Reactor* reactor); //处理监听socket的事件（新客户端连接请求）
+    void DealEvent_(Reactor* reactor, HttpConn* client, uint32_t events); //按连接状态机分发客户端事件
+    void DealWrite_(Reactor* reactor, HttpConn* client); //处理客户端的可写事件（发送响应）
+    void DealRead_(Reactor* reactor, HttpConn* client); //处理客户端的可读事件（读取请求）
+    void Dispatch_(Reactor* reactor, HttpConn* client, int action); //把连接的就绪任务节点投递给线程池
+    static void RunTask_(TaskNode* node); //就绪任务节点的执行函数（工作线程）
+    void CountRequest_(Reactor* reactor, int count); //统计完成的请求数（定期记录每个请求的epoll_ctl次数）
+
+#ifdef WEBSERVER_COROUTINE
+    //协程模式：每个连接一个协程，事件循环收到事件后直接恢复，只有阻塞操作才交给线程池
+    ConnCoroutine Serve_(Reactor* reactor, HttpConn* client); //连接的处理流程
+    void DealEventCo_(Reactor* reactor, HttpConn* client, uint32_t events); //按事件恢复协程
+    void ResumeCo_(Reactor* reactor, HttpConn* client); //恢复协程，协程结束时回收并关闭连接
+    static void ResumeTask_(TaskNode* node); //线程池中恢复协程
+
+    //co_await 等待可读/可写；返回false表示连接已挂断或超时
+    struct IoAwait {
+        HttpConn* client;
+        uint32_t want;
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<>) { client->Co().waiting = want; }
+        bool await_resume();
+    };
+    //co_await 切换到线程池执行
+    struct ToPool {
+        WebServer* server;
+        HttpConn* client;
+        bool await_ready() { return false; }
+        void await_suspend(std::coroutine_handle<> h);
+        void await_resume() {}
+    };
+    //co_await 切回所属事件循环
+    struct ToReactor {
+        WebServer* server;
+        Reactor* reactor;
+        HttpConn* client;
+        bool await_ready() { return false; }
+        void await_suspend(std::coroutine_handle<>) { server->Post_(reactor, client, CMD_RESUME); }
+        void await_resume() {}
+    };
+#endif
 
     //连接管理相关
     void SendError_(int fd, const char*info); //向客户端发送错误信息（如 404）
-    void ExtentTime_(HttpConn* client); //延长客户端连接的超时时间（有活动时调用）
-    void CloseConn_(HttpConn* client); //关闭客户端连接（从 Epoller、定时器中移除）
+    void ExtentTime_(Reactor* reactor, HttpConn* client); //延长客户端连接的超时时间（有活动时调用）
+    void CloseConn_(Reactor* reactor, HttpConn* client); //关闭客户端连接（从 Epoller、定时器中移除）
+    size_t MemUsage_() const; //连接占用的内存：缓冲区持有的块 + 连接对象
+    void EvictIdle_(Reactor* reactor); //内存超出预算时关闭本循环中最久没有活动的空闲连接
+
+    //工作线程与事件循环的通信
+    void Post_(Reactor* reactor, HttpConn* client, int op, uint32_t events = 0); //工作线程投递命令（持有连接期间）
+    void Post_(Reactor* reactor, int fd, uint32_t gen, int op, uint32_t events = 0); //按(fd, gen)投递，连接可能已交还
+    void Wake_(Reactor* reactor); //写eventfd唤醒事件循环（已有唤醒在途时跳过）
+    void DrainMailbox_(Reactor* reactor); //事件循环每轮批量取出命令，合并同一连接的命令后执行
 
     //业务处理相关
-    void OnRead_(HttpConn* client); //读取请求后的后续处理（解析请求）
-    void OnWrite_(HttpConn* client); //发送响应后的后续处理（判断是否保持连接）
-    void OnProcess(HttpConn* client); //处理请求的核心逻辑（生成响应）
+    //工作线程任务按(fd, 代数)定位连接，连接已关闭或fd已被复用时直接丢弃
+    void OnRead_(Reactor* reactor, int fd, uint32_t gen); //读取请求后的后续处理（解析请求）
+    void OnWrite_(Reactor* reactor, int fd, uint32_t gen); //发送响应后的后续处理（判断是否保持连接）
+    void OnProcess(Reactor* reactor, HttpConn* client, uint32_t gen, int action); //工作线程处理连接，直到需要等待事件
+    uint32_t DoRead_(Reactor* reactor, HttpConn* client); //读取+解析+尝试发送，返回下一个状态
+    uint32_t DoWrite_(Reactor* reactor, HttpConn* client); //发送响应，返回下一个状态
+    int Finish_(HttpConn* client, uint32_t next); //提交下一个状态，处理期间到达的事件转换为下一步动作
+    void Rearm_(Reactor* reactor, int fd, uint32_t gen, uint32_t state); //LT(ONESHOT)模式下请求事件循环按状态重新挂上关注事件
 
     static const int MAX_FD = 65536; //最大文件描述符数量（受限于系统配置，通常为 65536）
+    static const size_t MAILBOX_CAPACITY = 4096; //每个事件循环的命令队列槽数（2的幂），满时投递方让出CPU等待
+    static const int EVICT_SCAN = 256; //每轮最多检查的连接数（避免活跃连接很多时长时间遍历）
+    static const int64_t WATCHED_REVALIDATE_MS = 30000; //有inotify监视时缓存项的确认间隔
 
     static int SetFdNonblock(int fd); //静态方法：设置文件描述符为非阻塞模式（被多个地方复用）
+    void LogPlacement_(int threadNum); //启动时记录各线程绑定的CPU
 
     int port_; //服务器端口
     bool openLinger_; //是否启用 SO_LINGER（优雅关闭连接）
     int timeoutMS_; //连接超时时间（毫秒）
-    bool isClose_; //服务器是否关闭的标志
-    int listenFd_; //监听socket的文件描述符
+    size_t memBudget_; //连接内存预算（字节），0表示不限制
+    std::atomic<bool> isClose_; //服务器是否关闭的标志（多个事件循环线程共同读取）
+    bool reusePort_; //是否为监听socket开启SO_REUSEPORT（多Reactor模式）
+    bool useIoUring_; //是否优先使用io_uring后端（内核不支持时自动回退到epoll）
     char* srcDir_; //网页资源根目录（存放html、css等文件）
+    CpuPlacement placement_; //线程的CPU绑定策略（事件循环编号在前，工作线程编号在后）
     
     uint32_t listenEvent_; //监听socket的事件类型（如 EPOLLIN | EPOLLET）
     uint32_t connEvent_;  //客户端连接的事件类型（如 EPOLLIN | EPOLLOUT | EPOLLET）
    
-    std::unique_ptr<HeapTimer> timer_; //定时器（管理超时连接）
-    std::unique_ptr<ThreadPool> threadpool_; //线程池（处理业务逻辑）
-    std::unique_ptr<Epoller> epoller_; //IO 多路复用器（监视事件）
-    std::unordered_map<int, HttpConn> users_; //// 客户端连接映射（fd到HttpConn对象的映射，快速查找）
+    std::unique_ptr<WorkStealPool> threadpool_; //工作窃取线程池（处理业务逻辑，所有事件循环共享）
+    std::vector<std::unique_ptr<Reactor>> reactors_; //事件循环列表（单Reactor模式下只有一个）
+    std::vector<std::thread> loopThreads_; //多Reactor模式下，除0号循环外其余循环所在的线程
+    std::unique_ptr<ConnSlab> users_; //客户端连接表（按fd下标索引，所有事件循环共用，fd全局唯一）
+    std::unique_ptr<ResourceWatcher> watcher_; //资源目录变化时主动刷新文件缓存（未开启或inotify不可用时为空）
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,360 @@
+/*
+工作窃取线程池（替代 ThreadPool 的单队列+互斥锁+条件变量）：
+- 每个工作线程一个 Chase-Lev 双端队列：自己从底部压入/弹出，其他线程从顶部窃取；
+- 事件循环等外部线程通过无锁的有界 MPMC 注入队列（Vyukov）提交任务；
+- 空闲线程先自旋查找任务，仍找不到再通过 futex 睡眠；
+  提交任务时如果已有线程醒着在找任务（spinning_ > 0），就不再唤醒其他线程。
+接口与 ThreadPool 一致：AddTask；队列中保存的是侵入式任务节点指针，
+投递嵌入在连接对象中的 TaskNode 不分配内存，普通可调用对象则包装成一个堆上的节点。
+*/
+
+#ifndef WORKSTEALPOOL_H
+#define WORKSTEALPOOL_H
+
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <functional>
+#include <vector>
+#include <memory>
+#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "task.h"
+
+class WorkStealPool {
+public:
+    //threadInit：每个工作线程启动时以线程编号调用一次（如绑定CPU）
+    explicit WorkStealPool(int threadCount = 8, std::function<void(int)> threadInit = nullptr)
+        : threadInit_(std::move(threadInit)), inject_(INJECT_CAPACITY),
+          spinning_(0), sleepers_(0), epoch_(0), closed_(false) {
+        assert(threadCount > 0);
+        //同时自旋的线程数不超过核数的一半，避免空转的线程和事件循环抢CPU（单核时不自旋）
+        spinLimit_ = static_cast<int>(std::thread::hardware_concurrency()) / 2;
+        workers_.reserve(threadCount);
+        for (int i = 0; i < threadCount; i++) {
+            workers_.emplace_back(new Worker());
+        }
+        for (int i = 0; i < threadCount; i++) {
+            workers_[i]->thread_ = std::thread([this, i]() { Run_(i); });
+        }
+    }
+
+    //先处理完已提交的任务，再结束所有线程
+    ~WorkStealPool() {
+        closed_.store(true);
+        epoch_.fetch_add(1);
+        FutexWake_(INT32_MAX);
+        for (auto& w : workers_) {
+            if (w->thread_.joinable()) w->thread_.join();
+        }
+    }
+
+    WorkStealPool(const WorkStealPool&) = delete;
+    WorkStealPool& operator=(const WorkStealPool&) = delete;
+
+    template<typename T, class = typename std::enable_if<!std::is_convertible<T, TaskNode*>::value>::type>
+    void AddTask(T&& task) {
+        AddTask(new FuncNode(Task(std::forward<T>(task))));
+    }
+
+    //节点执行前不能重复投递，执行完后所有者可以再次投递
+    void AddTask(TaskNode* t) {
+        assert(t && t->run_);
+        Worker* self = Current_();
+        if (self && self->pool_ == this) {
+            self->deque_.Push(t); //工作线程提交的任务放进自己的队列
+        } else {
+            while (!inject_.Push(t)) {
+                Notify_(); //注入队列已满：确保有线程在消费，让出CPU后重试
+                std::this_thread::yield();
+            }
+        }
+        Notify_();
+    }
+
+private:
+    static const size_t INJECT_CAPACITY = 1 << 16;
+    static const int SPIN_ROUNDS = 64; //睡眠前查找任务的轮数
+
+    //普通可调用对象的节点：执行后释放自身
+    struct FuncNode : TaskNode {
+        explicit FuncNode(Task&& task) : task_(std::move(task)) { run_ = &FuncNode::Run_; }
+        static void Run_(TaskNode* node) {
+            FuncNode* self = static_cast<FuncNode*>(node);
+            self->task_();
+            delete self;
+        }
+        Task task_;
+    };
+
+    //Chase-Lev 双端队列（Lê 等人针对弱内存模型的版本）
+    //Push/Pop 只能由所属线程调用，Steal 可以由任意线程调用；容量不足时由所属线程扩容
+    class WsDeque {
+    public:
+        WsDeque() : top_(0), bottom_(0), array_(new Array(64)) {
+            (void)pad_;
+            retired_.emplace_back(array_.load(std::memory_order_relaxed));
+        }
+
+        void Push(TaskNode* t) {
+            int64_t b = bottom_.load(std::memory_order_relaxed);
+            int64_t top = top_.load(std::memory_order_acquire);
+            Array* a = array_.load(std::memory_order_relaxed);
+            if (b - top > a->cap_ - 1) {
+                a = Grow_(a, top, b);
+            }
+            a->Put(b, t);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+
+        TaskNode* Pop() {
+            int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+            Array* a = array_.load(std::memory_order_relaxed);
+            bottom_.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top_.load(std::memory_order_relaxed);
+            TaskNode* x = nullptr;
+            if (t <= b) {
+                x = a->Get(b);
+                if (t == b) {
+                    //只剩最后一个任务：与窃取者竞争
+                    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                        x = nullptr;
+                    }
+                    bottom_.store(b + 1, std::memory_order_relaxed);
+                }
+            } else {
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+            return x;
+        }
+
+        TaskNode* Steal() {
+            int64_t t = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom_.load(std::memory_order_acquire);
+            if (t >= b) {
+                return nullptr;
+            }
+            Array* a = array_.load(std::memory_order_acquire);
+            TaskNode* x = a->Get(t);
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr; //被其他线程抢先，放弃本次窃取
+            }
+            return x;
+        }
+
+        bool Empty() const {
+            return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct Array {
+            explicit Array(int64_t cap) : cap_(cap), buf_(new std::atomic<TaskNode*>[cap]) {}
+            TaskNode* Get(int64_t i) const { return buf_[i & (cap_ - 1)].load(std::memory_order_relaxed); }
+            void Put(int64_t i, TaskNode* t) { buf_[i & (cap_ - 1)].store(t, std::memory_order_relaxed); }
+            int64_t cap_; //2的幂
+            std::unique_ptr<std::atomic<TaskNode*>[]> buf_;
+        };
+
+        //窃取者可能仍在读旧数组，旧数组保留到队列销毁
+        Array* Grow_(Array* a, int64_t top, int64_t bottom) {
+            Array* na = new Array(a->cap_ * 2);
+            for (int64_t i = top; i < bottom; i++) {
+                na->Put(i, a->Get(i));
+            }
+            retired_.emplace_back(na);
+            array_.store(na, std::memory_order_release);
+            return na;
+        }
+
+        std::atomic<int64_t> top_; //窃取者修改
+        char pad_[64]; //top_与bottom_分在不同缓存行
+        std::atomic<int64_t> bottom_; //所属线程修改
+        std::atomic<Array*> array_;
+        std::vector<std::unique_ptr<Array>> retired_; //所有分配过的数组（只有所属线程修改）
+    };
+
+    //Vyukov 有界 MPMC 队列：每个槽带序号，生产者/消费者各用一次CAS占位
+    class InjectQueue {
+    public:
+        explicit InjectQueue(size_t capacity) : mask_(capacity - 1), cells_(new Cell[capacity]), enq_(0), deq_(0) {
+            (void)pad_;
+            assert((capacity & mask_) == 0);
+            for (size_t i = 0; i < capacity; i++) {
+                cells_[i].seq_.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        bool Push(TaskNode* t) {
+            size_t pos = enq_.load(std::memory_order_relaxed);
+            Cell* cell;
+            while (true) {
+                cell = &cells_[pos & mask_];
+                size_t seq = cell->seq_.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0) {
+                    if (enq_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                } else if (diff < 0) {
+                    return false; //已满
+                } else {
+                    pos = enq_.load(std::memory_order_relaxed);
+                }
+            }
+            cell->task_ = t;
+            cell->seq_.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        TaskNode* Pop() {
+            size_t pos = deq_.load(std::memory_order_relaxed);
+            Cell* cell;
+            while (true) {
+                cell = &cells_[pos & mask_];
+                size_t seq = cell->seq_.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (deq_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                } else if (diff < 0) {
+                    return nullptr; //为空
+                } else {
+                    pos = deq_.load(std::memory_order_relaxed);
+                }
+            }
+            TaskNode* t = cell->task_;
+            cell->seq_.store(pos + mask_ + 1, std::memory_order_release);
+            return t;
+        }
+
+        bool Empty() const {
+            return enq_.load(std::memory_order_relaxed) == deq_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> seq_;
+            TaskNode* task_;
+        };
+        const size_t mask_;
+        std::unique_ptr<Cell[]> cells_;
+        std::atomic<size_t> enq_; //生产者竞争
+        char pad_[64]; //enq_与deq_分在不同缓存行
+        std::atomic<size_t> deq_; //消费者竞争
+    };
+
+    struct Worker {
+        WsDeque deque_;
+        std::thread thread_;
+        WorkStealPool* pool_ = nullptr;
+        uint32_t rand_ = 0; //选择窃取对象的随机数状态
+    };
+
+    //当前线程所属的工作线程（非工作线程为nullptr）
+    static Worker*& Current_() {
+        static thread_local Worker* current = nullptr;
+        return current;
+    }
+
+    long FutexWait_(uint32_t expected) {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+    }
+
+    long FutexWake_(int n) {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAKE_PRIVATE, n, nullptr, nullptr, 0);
+    }
+
+    //有线程在睡眠且没有线程醒着找任务时，唤醒一个
+    void Notify_() {
+        if (spinning_.load() == 0 && sleepers_.load() > 0) {
+            epoch_.fetch_add(1);
+            FutexWake_(1);
+        }
+    }
+
+    bool HasWork_() const {
+        if (!inject_.Empty()) return true;
+        for (auto& w : workers_) {
+            if (!w->deque_.Empty()) return true;
+        }
+        return false;
+    }
+
+    //查找顺序：自己的队列 -> 注入队列 -> 从随机位置开始窃取其他线程
+    TaskNode* Find_(int i) {
+        Worker& self = *workers_[i];
+        TaskNode* t = self.deque_.Pop();
+        if (t) return t;
+        t = inject_.Pop();
+        if (t) return t;
+        int n = static_cast<int>(workers_.size());
+        self.rand_ ^= self.rand_ << 13;
+        self.rand_ ^= self.rand_ >> 17;
+        self.rand_ ^= self.rand_ << 5;
+        int start = static_cast<int>(self.rand_ % n);
+        for (int k = 0; k < n; k++) {
+            int v = (start + k) % n;
+            if (v == i) continue;
+            t = workers_[v]->deque_.Steal();
+            if (t) return t;
+        }
+        return nullptr;
+    }
+
+    void Run_(int i) {
+        Worker& self = *workers_[i];
+        self.pool_ = this;
+        self.rand_ = static_cast<uint32_t>(i) * 2654435761u + 1;
+        Current_() = &self;
+        if (threadInit_) {
+            threadInit_(i);
+        }
+
+        spinning_.fetch_add(1);
+        while (true) {
+            TaskNode* t = nullptr;
+            int rounds = spinning_.load() <= spinLimit_ ? SPIN_ROUNDS : 1;
+            for (int round = 0; round < rounds && !t; round++) {
+                t = Find_(i);
+                if (!t && round + 1 < rounds) std::this_thread::yield();
+            }
+            if (!t) {
+                if (closed_.load()) break;
+                //准备睡眠：先登记为睡眠者再最后检查一次，避免与提交者的唤醒判断错过
+                uint32_t e = epoch_.load();
+                sleepers_.fetch_add(1);
+                spinning_.fetch_sub(1);
+                t = Find_(i);
+                if (!t && !closed_.load()) {
+                    FutexWait_(e);
+                }
+                sleepers_.fetch_sub(1);
+                spinning_.fetch_add(1);
+                if (!t) continue;
+            }
+            //最后一个醒着的线程拿到了任务：还有剩余任务时再唤醒一个，保证有线程接手
+            if (spinning_.fetch_sub(1) == 1 && HasWork_()) {
+                Notify_();
+            }
+            t->Run();
+            spinning_.fetch_add(1);
+        }
+        spinning_.fetch_sub(1);
+        Current_() = nullptr;
+    }
+
+    std::function<void(int)> threadInit_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    InjectQueue inject_;
+    int spinLimit_; //允许同时自旋的线程数
+    std::atomic<int> spinning_; //醒着查找任务的线程数
+    std::atomic<int> sleepers_; //在futex上睡眠（或正准备睡眠）的线程数
+    std::atomic<uint32_t> epoch_; //futex字，每次唤醒递增
+    std::atomic<bool> closed_;
+};
+
+#endif
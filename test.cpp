@@ -1,6 +1,26 @@
 #include "code/log.h"
 #include "code/threadpool.h"
+#include "code/workstealpool.h"
+#include "code/buffer.h"
+#include "code/httpconn.h"
+#include "code/charscan.h"
 #include <features.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 // 适配旧版本glibc获取线程ID（gettid()）
 #if __GLIBC__ == 2 && __GLIBC_MINOR__ < 30
@@ -45,7 +65,588 @@ void TestThreadPool() {
     getchar();
 }
 
+//线程池微基准：模拟事件循环单线程提交大量小任务
+//统计吞吐（任务数/秒）与从提交到开始执行的延迟 p50/p99
+template<class Pool>
+void BenchPool(const char* name, int threads, int tasks) {
+    typedef std::chrono::steady_clock BenchClock;
+    std::vector<int64_t> latency(tasks);
+    std::atomic<int> done(0);
+    BenchClock::time_point start = BenchClock::now();
+    {
+        Pool pool(threads);
+        for(int i = 0; i < tasks; i++) {
+            int64_t enq = BenchClock::now().time_since_epoch().count();
+            pool.AddTask([&latency, &done, i, enq]() {
+                latency[i] = BenchClock::now().time_since_epoch().count() - enq;
+                done.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+        while(done.load() < tasks) {
+            std::this_thread::yield();
+        }
+    }
+    double sec = std::chrono::duration<double>(BenchClock::now() - start).count();
+    std::sort(latency.begin(), latency.end());
+    printf("%-14s threads:%d tasks:%d  %.0f tasks/s  p50:%.1fus  p99:%.1fus\n", name, threads, tasks,
+           tasks / sec, latency[tasks / 2] / 1000.0, latency[tasks * 99 / 100] / 1000.0);
+}
+
+void TestThreadPoolBench() {
+    const int tasks = 1000000;
+    for(int threads : {1, 4, 8}) {
+        BenchPool<ThreadPool>("ThreadPool", threads, tasks);
+        BenchPool<WorkStealPool>("WorkStealPool", threads, tasks);
+    }
+}
+
+//进程当前的常驻内存（字节）
+static long ResidentBytes() {
+    long pages = 0, resident = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp) {
+        if (fscanf(fp, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        fclose(fp);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+//空闲长连接内存基准：每个连接收过一个请求、发过一个响应头后进入空闲，
+//比较空闲时保留缓冲区与归还缓冲区两种情况下每个连接的常驻内存（不含内核socket缓冲区）
+//每种情况在子进程中测量，互不影响堆的状态
+void BenchIdleConnMemory(int conns, bool release) {
+    if (fork() != 0) {
+        wait(nullptr);
+        return;
+    }
+    std::string request = "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1:1316\r\n"
+                          "User-Agent: bench\r\nAccept: */*\r\nConnection: keep-alive\r\n\r\n";
+    std::string header = "HTTP/1.1 200 OK\r\nConnection: keep-alive\r\n"
+                         "keep-alive: max=6, timeout=120\r\nContent-type: text/html\r\nContent-length: 3148\r\n\r\n";
+    long before = ResidentBytes();
+    std::unique_ptr<Buffer[]> readBuffs(new Buffer[conns]);
+    std::unique_ptr<Buffer[]> writeBuffs(new Buffer[conns]);
+    for (int i = 0; i < conns; i++) {
+        readBuffs[i].Append(request);
+        readBuffs[i].RetrieveAll();
+        writeBuffs[i].Append(header);
+        writeBuffs[i].RetrieveAll();
+        if (release) {
+            readBuffs[i].Release();
+            writeBuffs[i].Release();
+        }
+    }
+    long perConn = (ResidentBytes() - before) / conns;
+    //连接对象中除两个缓冲区之外的部分（请求/响应对象等）
+    long connObj = static_cast<long>(sizeof(HttpConn) - 2 * sizeof(Buffer));
+    printf("%-16s conns:%-7d resident per idle conn: %6ld bytes (buffers %ld + HttpConn %ld)\n",
+           release ? "release buffers" : "keep buffers", conns, perConn + connObj, perConn, connObj);
+    fflush(stdout);
+    _exit(0);
+}
+
+void TestIdleConnMemoryBench() {
+    for (int conns : {10000, 50000, 100000}) {
+        BenchIdleConnMemory(conns, false);
+        BenchIdleConnMemory(conns, true);
+    }
+}
+
+//请求解析微基准：同一缓冲区反复解析一个典型的浏览器请求（只走GET路径，不访问数据库）
+//报告每秒解析的请求数，以及x86上每个CPU周期处理的字节数
+void BenchParser(const char* name, const std::string& request, int rounds) {
+    Buffer buff;
+    HttpRequest req;
+    typedef std::chrono::steady_clock BenchClock;
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned long long cycles = 0;
+#endif
+    double sec = 0;
+    int ok = 0;
+    for (int i = 0; i < rounds; i++) {
+        buff.Append(request);
+        BenchClock::time_point start = BenchClock::now();
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned long long c0 = __rdtsc();
+#endif
+        req.Init();
+        ok += req.parse(buff) == HttpRequest::PARSE_OK;
+#if defined(__x86_64__) || defined(__i386__)
+        cycles += __rdtsc() - c0;
+#endif
+        sec += std::chrono::duration<double>(BenchClock::now() - start).count();
+        buff.RetrieveAll();
+    }
+    printf("%-10s %5d bytes  ok:%d  %.0f req/s", name, (int)request.size(), ok, rounds / sec);
+#if defined(__x86_64__) || defined(__i386__)
+    printf("  %.2f bytes/cycle", static_cast<double>(request.size()) * rounds / cycles);
+#endif
+    printf("\n");
+}
+
+void TestParserBench() {
+    const int rounds = 1000000;
+    std::string small = "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1:1316\r\nConnection: keep-alive\r\n\r\n";
+    std::string browser = "GET /picture.html HTTP/1.1\r\n"
+        "Host: 127.0.0.1:1316\r\n"
+        "Connection: keep-alive\r\n"
+        "Cache-Control: max-age=0\r\n"
+        "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+        "sec-ch-ua-mobile: ?0\r\n"
+        "sec-ch-ua-platform: \"Linux\"\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Sec-Fetch-Site: same-origin\r\n"
+        "Sec-Fetch-Mode: navigate\r\n"
+        "Sec-Fetch-Dest: document\r\n"
+        "Referer: http://127.0.0.1:1316/index.html\r\n"
+        "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "If-None-Match: \"ce800e-ce-6ad22f950027050c3\"\r\n"
+        "If-Modified-Since: Fri, 16 Oct 2026 14:07:17 GMT\r\n\r\n";
+    BenchParser("small", small, rounds);
+    BenchParser("browser", browser, rounds);
+}
+
+//浏览器请求语料：带不同大小Cookie的页面请求，以及一个表单POST
+static std::vector<std::pair<std::string, std::string>> BrowserCorpus() {
+    std::string common = "Host: 127.0.0.1:1316\r\n"
+        "Connection: keep-alive\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "Referer: http://127.0.0.1:1316/index.html\r\n";
+    //分析/广告类Cookie：大量 name=value 对，值是长的随机串
+    auto cookie = [](size_t bytes) {
+        std::string c = "Cookie: ";
+        for (int i = 0; c.size() < bytes; i++) {
+            c += "_ga_" + std::to_string(i) + "=GS1.1." + std::string(40 + i % 23, 'a' + i % 26) + "; ";
+        }
+        return c + "\r\n";
+    };
+    std::string form = "username=zhang+san&password=p%40ss%20word&";
+    while (form.size() < 2048) form += "field" + std::to_string(form.size()) + "=v%E4%B8%AD+x&";
+    //留言/文章类表单：少数字段，值是长文本
+    std::string text = "title=hello&content=";
+    while (text.size() < 4096) text += "Lorem_ipsum_dolor_sit_amet.consectetur_adipiscing_elit.sed_do_eiusmod%0A";
+    std::vector<std::pair<std::string, std::string>> corpus;
+    corpus.emplace_back("page", "GET /picture.html HTTP/1.1\r\n" + common + "\r\n");
+    corpus.emplace_back("cookie-1k", "GET /picture.html HTTP/1.1\r\n" + common + cookie(1024) + "\r\n");
+    corpus.emplace_back("cookie-4k", "GET /picture.html HTTP/1.1\r\n" + common + cookie(4096) + "\r\n");
+    corpus.emplace_back("cookie-8k", "GET /picture.html HTTP/1.1\r\n" + common + cookie(8192) + "\r\n");
+    corpus.emplace_back("form-2k", "POST /picture HTTP/1.1\r\n" + common +
+                        "Content-Type: application/x-www-form-urlencoded\r\n"
+                        "Content-Length: " + std::to_string(form.size()) + "\r\n\r\n" + form);
+    corpus.emplace_back("form-text", "POST /picture HTTP/1.1\r\n" + common +
+                        "Content-Type: application/x-www-form-urlencoded\r\n"
+                        "Content-Length: " + std::to_string(text.size()) + "\r\n\r\n" + text);
+    return corpus;
+}
+
+//扫描基准：每种实现（CPU支持时）分别测量各个扫描函数的吞吐（GB/s）和整个请求的解析速度
+void TestCharScanBench() {
+    typedef std::chrono::steady_clock BenchClock;
+    const int rounds = 200000;
+    CharScan::ISA native = CharScan::Active();
+    auto corpus = BrowserCorpus();
+    for (int isa = 0; isa < CharScan::ISA_COUNT; isa++) {
+        if (!CharScan::Use(static_cast<CharScan::ISA>(isa))) {
+            continue;
+        }
+        printf("== %s\n", CharScan::IsaName(CharScan::Active()));
+        for (const auto& item : corpus) {
+            const std::string& req = item.second;
+            const char* begin = req.data();
+            const char* end = begin + req.size();
+            const char* head = CharScan::FindHeadEnd(begin, end);
+            size_t sink = 0;
+            //请求头结束
+            BenchClock::time_point t0 = BenchClock::now();
+            for (int i = 0; i < rounds; i++) {
+                sink += CharScan::FindHeadEnd(begin, end) - begin;
+            }
+            //按行切分 + 字段值检查
+            BenchClock::time_point t1 = BenchClock::now();
+            for (int i = 0; i < rounds; i++) {
+                for (const char* line = begin; line < head;) {
+                    const char* eol = CharScan::FindCrlf(line, head + 2);
+                    sink += CharScan::FindCtl(line, eol) - line;
+                    line = eol + 2;
+                }
+            }
+            //表单请求体切分
+            BenchClock::time_point t2 = BenchClock::now();
+            for (int i = 0; i < rounds; i++) {
+                for (const char* p = head + 4; p < end; p++) {
+                    p = CharScan::FindFormDelim(p, end);
+                    sink++;
+                }
+            }
+            BenchClock::time_point t3 = BenchClock::now();
+            double headBytes = static_cast<double>(head + 4 - begin) * rounds;
+            double bodyBytes = static_cast<double>(end - head - 4) * rounds;
+            auto gbps = [](double bytes, BenchClock::duration d) {
+                return bytes / std::chrono::duration<double>(d).count() / 1e9;
+            };
+            printf("%-10s head-end %5.2f GB/s  lines %5.2f GB/s", item.first.c_str(),
+                   gbps(headBytes, t1 - t0), gbps(headBytes, t2 - t1));
+            if (bodyBytes > 0) {
+                printf("  form %5.2f GB/s", gbps(bodyBytes, t3 - t2));
+            }
+            printf("  (%zu)\n", sink % 10);
+        }
+        for (const auto& item : corpus) {
+            if (item.second.compare(0, 4, "GET ") == 0) { //POST会走数据库验证，只测GET
+                BenchParser(item.first.c_str(), item.second, rounds);
+            }
+        }
+    }
+    CharScan::Use(native);
+}
+
+//分段到达的请求：每次追加piece字节后调用一次parse，直到请求完整
+//续扫描时每个字节只扫描一次，总耗时应与分段大小基本无关（不随段数平方增长）
+void TestFragmentedParseBench() {
+    typedef std::chrono::steady_clock BenchClock;
+    const std::string request = BrowserCorpus()[3].second; //8KB Cookie
+    for (size_t piece : {static_cast<size_t>(1), static_cast<size_t>(16), static_cast<size_t>(256),
+                         static_cast<size_t>(1460), request.size()}) {
+        const int rounds = piece == 1 ? 200 : 20000;
+        Buffer buff;
+        HttpRequest req;
+        int calls = 0, ok = 0;
+        BenchClock::time_point start = BenchClock::now();
+        for (int i = 0; i < rounds; i++) {
+            HttpRequest::PARSE_RESULT r = HttpRequest::PARSE_AGAIN;
+            for (size_t off = 0; off < request.size() && r == HttpRequest::PARSE_AGAIN; off += piece) {
+                buff.Append(request.data() + off, std::min(piece, request.size() - off));
+                r = req.parse(buff);
+                calls++;
+            }
+            ok += r == HttpRequest::PARSE_OK;
+            buff.Retrieve(req.Consumed());
+        }
+        double us = std::chrono::duration<double, std::micro>(BenchClock::now() - start).count() / rounds;
+        printf("piece %5zu bytes: %5d parse calls/request  %8.2f us/request  ok:%d\n",
+               piece, calls / rounds, us, ok);
+    }
+}
+
+//请求体接收的行为测试：socketpair一端当作客户端，另一端交给HttpConn（ET模式），请求体分多次到达
+//定长的大请求体在请求头之后的部分由splice直接搬进临时文件，分块请求体边到达边解码，两种都必须收完并得到响应
+//请求体由/upload上的流式处理函数检查：长度、存放位置（临时文件或内存）和每个字节都要与发送的一致
+static std::string uploadExpect; //期望收到的请求体（解码后）
+static bool uploadSpooled; //处理函数看到的请求体是否在临时文件中
+static bool uploadMatched; //处理函数看到的请求体是否与期望一致
+
+static void AddUploadHandler() {
+    HttpConn::AddStream("/upload", "text/plain", [](const HttpRequest& req) {
+        std::string got;
+        uploadSpooled = req.BodyFd() >= 0;
+        if (uploadSpooled) {
+            struct stat st;
+            if (fstat(req.BodyFd(), &st) == 0 && st.st_size >= 0) {
+                got.resize(st.st_size);
+                size_t n = 0;
+                ssize_t r;
+                while (n < got.size() && (r = pread(req.BodyFd(), &got[n], got.size() - n, n)) > 0) {
+                    n += r;
+                }
+                got.resize(n);
+            }
+        } else {
+            got = req.Body();
+        }
+        uploadMatched = req.BodySize() == uploadExpect.size() && got == uploadExpect;
+        return StreamBody::Producer(); //空响应体
+    });
+}
+
+//code：期望的状态码；200时还检查处理函数看到的请求体
+static bool UploadOnce(const char* name, const std::string& request, size_t firstPart, int code, bool spooled) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        return false;
+    }
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    fcntl(sv[1], F_SETFL, O_NONBLOCK);
+    HttpConn conn;
+    sockaddr_in addr = {};
+    conn.Init(sv[1], addr);
+    int err = 0;
+    bool done = false;
+    size_t pos = 0;
+    uploadMatched = uploadSpooled = false;
+    //先只发请求头和一小段请求体，之后每次发送后都走一遍读取+解析，和事件循环的顺序相同
+    while (!done && pos < request.size()) {
+        size_t want = pos == 0 ? firstPart : request.size() - pos;
+        ssize_t n = write(sv[0], request.data() + pos, want);
+        if (n > 0) {
+            pos += n;
+        }
+        conn.read(&err);
+        done = conn.process();
+    }
+    for (int i = 0; i < 3 && !done; i++) {
+        conn.read(&err);
+        done = conn.process();
+    }
+    std::string response;
+    if (done) {
+        conn.write(&err);
+        char buf[4096];
+        ssize_t n = read(sv[0], buf, sizeof(buf));
+        if (n > 0) {
+            response.assign(buf, n);
+        }
+    }
+    close(sv[0]);
+    bool ok = done && response.compare(0, 13, "HTTP/1.1 " + std::to_string(code) + " ") == 0;
+    if (code == 200) {
+        ok = ok && pos == request.size() && uploadMatched && uploadSpooled == spooled;
+    }
+    printf("%-18s %7zu bytes  done:%d  %.12s  %s\n", name, request.size(), done,
+           response.c_str(), ok ? "OK" : "FAIL");
+    return ok;
+}
+
+static std::string Chunked(const std::string& body) {
+    std::string chunked = "POST /upload HTTP/1.1\r\nHost: t\r\nTransfer-Encoding: chunked\r\n\r\n";
+    //块的大小不一，每块按到达的字节解码
+    for (size_t p = 0, n = 1; p < body.size(); p += n, n = n * 3 % 40000 + 1) {
+        n = std::min(n, body.size() - p);
+        char size[32];
+        snprintf(size, sizeof(size), "%zx\r\n", n);
+        chunked += size + body.substr(p, n) + "\r\n";
+    }
+    return chunked + "0\r\n\r\n";
+}
+
+void TestBodyUpload() {
+    HttpConn::isET = true;
+    HttpConn::srcDir = "./resources";
+    AddUploadHandler();
+    std::string body(300 * 1024, 'x');
+    for (size_t i = 0; i < body.size(); i++) {
+        body[i] = static_cast<char>('a' + i * 7 % 26);
+    }
+    uploadExpect = body;
+    //Content-Length超过spoolSize：请求头之后的部分由splice写入临时文件
+    std::string spooled = "POST /upload HTTP/1.1\r\nHost: t\r\nContent-Length: " + std::to_string(body.size())
+                          + "\r\n\r\n" + body;
+    UploadOnce("spooled", spooled, 1024, 200, true);
+    //分块请求体：解码后超过spoolSize，也写入临时文件
+    UploadOnce("chunked", Chunked(body), 1024, 200, true);
+    //小请求体：整个留在读缓冲区中解析
+    uploadExpect = "hello";
+    UploadOnce("in-buffer", "POST /upload HTTP/1.1\r\nHost: t\r\nContent-Length: 5\r\n\r\nhello", 40, 200, false);
+    uploadExpect = body.substr(0, 1000);
+    UploadOnce("chunked small", Chunked(uploadExpect), 100, 200, false);
+    //超过maxBodySize：定长的在请求头到齐时、分块的在累计长度超出时回复413
+    size_t maxBody = HttpRequest::maxBodySize;
+    HttpRequest::maxBodySize = 200 * 1024;
+    UploadOnce("too large", spooled, 1024, 413, false);
+    UploadOnce("chunked too large", Chunked(body), 1024, 413, false);
+    HttpRequest::maxBodySize = maxBody;
+}
+
+//响应生成的行为测试：资源目录放在临时目录中，直接调用HttpResponse，检查状态行、响应头和要发送的区间
+static std::string respDir;
+
+static void WriteFile(const std::string& name, const std::string& content) {
+    FILE* fp = fopen((respDir + name).c_str(), "w");
+    fwrite(content.data(), 1, content.size(), fp);
+    fclose(fp);
+}
+
+struct ResponseReq {
+    std::string range, ifRange, ifNoneMatch, ifModifiedSince, acceptEncoding;
+};
+
+//返回响应头，ranges取回206的各段
+static std::string Respond(const std::string& name, const ResponseReq& req,
+                           std::vector<HttpResponse::BodyRange>* ranges = nullptr) {
+    HttpResponse response;
+    std::string path = name;
+    response.Init(respDir, path, false);
+    response.SetConditional(req.ifNoneMatch, req.ifModifiedSince);
+    response.SetEncoding(req.acceptEncoding);
+    response.SetRange(req.range, req.ifRange);
+    Buffer buff;
+    response.MakeResponse(buff);
+    if (ranges) {
+        *ranges = response.Ranges();
+    }
+    return buff.RetrieveAllToStr();
+}
+
+static bool HasLine(const std::string& head, const std::string& line) {
+    return head.find("\r\n" + line + "\r\n") != std::string::npos;
+}
+
+//响应头中某个字段的值，没有时返回空串
+static std::string HeaderValue(const std::string& head, const std::string& name) {
+    size_t pos = head.find("\r\n" + name + ": ");
+    if (pos == std::string::npos) {
+        return "";
+    }
+    pos += name.size() + 4;
+    return head.substr(pos, head.find("\r\n", pos) - pos);
+}
+
+static int respFailed = 0;
+
+static void Check(const char* name, bool ok) {
+    printf("%-40s %s\n", name, ok ? "OK" : "FAIL");
+    respFailed += ok ? 0 : 1;
+}
+
+static void SetUpRespDir() {
+    char dir[] = "/tmp/wsrespXXXXXX";
+    respDir = mkdtemp(dir);
+    std::string text(1000, 'x');
+    for (size_t i = 0; i < text.size(); i++) {
+        text[i] = static_cast<char>('a' + i % 26);
+    }
+    WriteFile("/a.txt", text);
+    WriteFile("/a.txt.gz", std::string(300, 'z')); //预先压缩好的版本，内容不重要
+}
+
+static void TearDownRespDir() {
+    unlink((respDir + "/a.txt").c_str());
+    unlink((respDir + "/a.txt.gz").c_str());
+    rmdir(respDir.c_str());
+    FileCache::Instance()->Clear();
+}
+
+//带Range时发送原文件的区间：压缩版本的字节不能当作原文件发出
+void TestRangeEncoding() {
+    SetUpRespDir();
+    std::vector<HttpResponse::BodyRange> ranges;
+    ResponseReq req;
+    req.acceptEncoding = "gzip";
+    std::string head = Respond("/a.txt", req);
+    Check("gzip accepted -> gzip variant", head.compare(0, 15, "HTTP/1.1 200 OK") == 0
+          && HasLine(head, "Content-Encoding: gzip") && HasLine(head, "Content-length: 300"));
+    req.range = "bytes=0-9";
+    head = Respond("/a.txt", req, &ranges);
+    Check("range + gzip -> identity 206", head.compare(0, 12, "HTTP/1.1 206") == 0
+          && head.find("Content-Encoding") == std::string::npos && HasLine(head, "Content-Range: bytes 0-9/1000")
+          && ranges.size() == 1 && ranges[0].start == 0 && ranges[0].len == 10);
+    req.range = "bytes=0-0,990-";
+    head = Respond("/a.txt", req, &ranges);
+    Check("multi range + gzip -> identity 206", head.compare(0, 12, "HTTP/1.1 206") == 0
+          && head.find("Content-Encoding") == std::string::npos && ranges.size() == 3
+          && ranges[1].head.find("Content-Range: bytes 990-999/1000") != std::string::npos);
+    TearDownRespDir();
+}
+
+//Range的解析：后缀区间、越界、多段、段数上限、语法错误和If-Range
+void TestRangeParse() {
+    SetUpRespDir();
+    std::vector<HttpResponse::BodyRange> ranges;
+    ResponseReq req;
+    std::string etag = HeaderValue(Respond("/a.txt", req), "ETag");
+    std::string lastModified = HeaderValue(Respond("/a.txt", req), "Last-Modified");
+    auto single = [&](const char* range, off_t start, size_t len) {
+        req.range = range;
+        std::string head = Respond("/a.txt", req, &ranges);
+        return head.compare(0, 12, "HTTP/1.1 206") == 0 && ranges.size() == 1 && ranges[0].start == start
+               && ranges[0].len == len && HasLine(head, "Content-length: " + std::to_string(len));
+    };
+    auto code = [&](const char* range) {
+        req.range = range;
+        return Respond("/a.txt", req, &ranges).substr(9, 3);
+    };
+    Check("bytes=0-9", single("bytes=0-9", 0, 10));
+    Check("bytes=-5 (suffix)", single("bytes=-5", 995, 5));
+    Check("bytes=-2000 (suffix longer than file)", single("bytes=-2000", 0, 1000));
+    Check("bytes=990- (open end)", single("bytes=990-", 990, 10));
+    Check("bytes=995-5000 (end clamped)", single("bytes=995-5000", 995, 5));
+    Check("bytes=-0 -> 416", code("bytes=-0") == "416");
+    req.range = "bytes=1000-";
+    Check("bytes=1000- -> 416 with size", HasLine(Respond("/a.txt", req), "Content-Range: bytes */1000"));
+    Check("bytes=5-3 -> 200 (ignored)", code("bytes=5-3") == "200" && ranges.empty());
+    Check("bytes=abc -> 200 (ignored)", code("bytes=abc") == "200");
+    Check("items=0-9 -> 200 (unknown unit)", code("items=0-9") == "200");
+    std::string many = "bytes=0-0";
+    for (int i = 1; i < 16; i++) {
+        many += "," + std::to_string(i * 10) + "-" + std::to_string(i * 10);
+    }
+    req.range = many;
+    std::string head = Respond("/a.txt", req, &ranges);
+    Check("16 ranges -> multipart 206", head.compare(0, 12, "HTTP/1.1 206") == 0 && ranges.size() == 17
+          && HeaderValue(head, "Content-type").compare(0, 31, "multipart/byteranges; boundary=") == 0);
+    many += ",500-500";
+    Check("17 ranges -> 200 (ignored)", code(many.c_str()) == "200" && ranges.empty());
+    req.range = "bytes=0-9";
+    req.ifRange = etag;
+    Check("If-Range current ETag -> 206", code("bytes=0-9") == "206");
+    req.ifRange = lastModified;
+    Check("If-Range current date -> 206", code("bytes=0-9") == "206");
+    req.ifRange = "\"stale\"";
+    Check("If-Range mismatch -> 200 full", code("bytes=0-9") == "200" && ranges.empty());
+    TearDownRespDir();
+}
+
+//条件请求：If-None-Match（弱比较、列表、*）优先于If-Modified-Since，304先于Range判断
+void TestConditional() {
+    SetUpRespDir();
+    ResponseReq req;
+    std::string head = Respond("/a.txt", req);
+    std::string etag = HeaderValue(head, "ETag");
+    std::string lastModified = HeaderValue(head, "Last-Modified");
+    auto code = [&](const ResponseReq& r) { return Respond("/a.txt", r).substr(9, 3); };
+    ResponseReq inm;
+    inm.ifNoneMatch = etag;
+    head = Respond("/a.txt", inm);
+    Check("If-None-Match current -> 304", head.substr(9, 3) == "304" && HasLine(head, "ETag: " + etag)
+          && head.find("Content-length") == std::string::npos);
+    inm.ifNoneMatch = "W/" + etag;
+    Check("If-None-Match weak -> 304", code(inm) == "304");
+    inm.ifNoneMatch = "\"other\", " + etag;
+    Check("If-None-Match list -> 304", code(inm) == "304");
+    inm.ifNoneMatch = "*";
+    Check("If-None-Match * -> 304", code(inm) == "304");
+    inm.ifNoneMatch = "\"other\"";
+    Check("If-None-Match mismatch -> 200", code(inm) == "200");
+    ResponseReq ims;
+    ims.ifModifiedSince = lastModified;
+    Check("If-Modified-Since current -> 304", code(ims) == "304");
+    ims.ifModifiedSince = "Thu, 01 Jan 1970 00:00:00 GMT";
+    Check("If-Modified-Since older -> 200", code(ims) == "200");
+    ims.ifModifiedSince = "yesterday";
+    Check("If-Modified-Since malformed -> 200", code(ims) == "200");
+    ims.ifModifiedSince = lastModified;
+    ims.ifNoneMatch = "\"other\"";
+    Check("If-None-Match wins over If-Modified-Since", code(ims) == "200");
+    ResponseReq both;
+    both.ifNoneMatch = etag;
+    both.range = "bytes=5000-";
+    Check("304 takes precedence over 416", code(both) == "304");
+    //压缩版本有自己的ETag：原文件的ETag不能让客户端继续使用压缩版本，反之亦然
+    ResponseReq gz;
+    gz.acceptEncoding = "gzip";
+    std::string gzEtag = HeaderValue(Respond("/a.txt", gz), "ETag");
+    gz.ifNoneMatch = gzEtag;
+    Check("gzip ETag differs from identity", !gzEtag.empty() && gzEtag != etag && code(gz) == "304");
+    gz.ifNoneMatch = etag;
+    Check("identity ETag on gzip request -> 200", code(gz) == "200");
+    TearDownRespDir();
+}
+
 int main() {
     // TestLog();
+    // TestThreadPoolBench();
+    // TestIdleConnMemoryBench();
+    // TestParserBench();
+    // TestCharScanBench();
+    // TestFragmentedParseBench();
+    TestBodyUpload();
+    TestRangeEncoding();
+    TestRangeParse();
+    TestConditional();
     TestThreadPool();
 }
\ No newline at end of file